@@ -0,0 +1,149 @@
+// CMSC 341 - Fall 2023 - Project 3
+#ifndef BASICPQUEUE_H
+#define BASICPQUEUE_H
+
+#include "pqueue.h"
+#include <functional>
+using namespace std;
+
+// Turns a priority function into a functor type, so BasicPQueue can call
+// it directly, e.g. BasicPQueue<PriorityFnOf<priorityFn2>, less<int>, SKEW>
+template <prifn_t Fn>
+struct PriorityFnOf {
+    int operator()(const Patient& patient) const {return Fn(patient);}
+};
+
+template <class Priority, class Compare = less<int>, STRUCTURE Structure = SKEW>
+class BasicPQueue {
+    // A queue whose priority function, order and structure are fixed at
+    // compile time.  Priority is a functor that returns the priority of a
+    // patient and Compare(key1, key2) is true if key1 comes out first, so
+    // less<int> makes a min heap and greater<int> a max heap.  The merges
+    // are the same HeapKernels PQueue uses, but here every comparison and
+    // priority call can be inlined and no branch on the heap type or
+    // structure is left.  PQueue is the choice when the priority function
+    // or structure is picked at run time.  Only the pointer based heaps
+    // are supported.
+    static_assert(Structure != DARY, "BasicPQueue has no DARY heap");
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    explicit BasicPQueue(Priority priority = Priority(), Compare compare = Compare())
+        : m_heap(nullptr), m_size(0), m_priority(priority), m_compare(compare) {}
+    // the pool frees its slabs when it is destroyed
+    ~BasicPQueue() {}
+    void insertPatient(const Patient& patient) {
+        Node* newNode = m_pool.allocate(patient, m_priority(patient));
+        m_heap = mergeNodes(m_heap, newNode);
+        m_size++;
+    }
+    // the key is computed before the patient is moved into the node
+    void insertPatient(Patient&& patient) {
+        int key = m_priority(patient);
+        Node* newNode = m_pool.allocate(std::move(patient), key);
+        m_heap = mergeNodes(m_heap, newNode);
+        m_size++;
+    }
+    // Inserts a batch of patients with a single merge, like PQueue does
+    template <class InputIt>
+    void insertPatients(InputIt first, InputIt last) {
+        vector<Node*> nodes;
+        for (; first != last; ++first) {
+            int key = m_priority(*first);
+            nodes.push_back(m_pool.allocate(*first, key));
+        }
+        m_size += (int)nodes.size();
+        m_heap = mergeNodes(m_heap, meldAll(nodes));
+    }
+    // Throws out_of_range if the queue is empty
+    Patient getNextPatient() {
+        if (m_size == 0) {
+            throw out_of_range("The heap is empty");
+        }
+
+        Node* root = m_heap;
+        Patient temp = std::move(root->m_patient);
+        if (Structure == PAIRING) {
+            m_heap = HeapKernels::combineSiblings(root->m_left, m_mergePath, m_compare);
+        }
+        else {
+            m_heap = mergeNodes(root->m_left, root->m_right);
+        }
+        m_pool.release(root);
+        m_size--;
+        return temp;
+    }
+    // Throws out_of_range if the queue is empty
+    const Patient& peekNextPatient() const {
+        if (m_size == 0) {
+            throw out_of_range("The heap is empty");
+        }
+        return m_heap->m_patient;
+    }
+    // takes over every node of rhs and leaves it empty
+    void mergeWithQueue(BasicPQueue& rhs) {
+        if (this == &rhs) {
+            return;
+        }
+        m_heap = mergeNodes(m_heap, rhs.m_heap);
+        m_size += rhs.m_size;
+        m_pool.adopt(rhs.m_pool);
+        rhs.m_heap = nullptr;
+        rhs.m_size = 0;
+    }
+    void clear() {
+        m_pool.releaseAll();
+        m_heap = nullptr;
+        m_size = 0;
+    }
+    int numPatients() const {return m_size;}
+
+private:
+    typedef NodeOf<Patient> Node;
+
+    Node* m_heap;
+    int m_size;
+    Priority m_priority;
+    Compare m_compare;
+    vector<Node*> m_mergePath; // scratch space for the kernels, not copied
+    NodePoolOf<Patient> m_pool; // owns every node in m_heap
+
+    BasicPQueue(const BasicPQueue& rhs);            // not copyable
+    BasicPQueue& operator=(const BasicPQueue& rhs); // not copyable
+
+    // Structure is a constant, so only one of the kernels is compiled in
+    Node* mergeNodes(Node* p1, Node* p2) {
+        Node* root;
+        if (Structure == SKEW) {
+            root = HeapKernels::mergeSkew(p1, p2, m_compare);
+        }
+        else if (Structure == PAIRING) {
+            root = HeapKernels::mergePairing(p1, p2, m_compare);
+        }
+        else {
+            root = HeapKernels::mergeLeftist(p1, p2, m_mergePath, m_compare);
+        }
+        if (root) {
+            root->m_parent = nullptr;
+        }
+        return root;
+    }
+
+    // merges one node heaps in pairs, round after round, in O(n)
+    Node* meldAll(vector<Node*>& roots) {
+        int count = (int)roots.size();
+        while (count > 1) {
+            int merged = 0;
+            for (int i = 0; i + 1 < count; i += 2) {
+                roots[merged++] = mergeNodes(roots[i], roots[i + 1]);
+            }
+            if (count % 2 == 1) {
+                roots[merged++] = roots[count - 1];
+            }
+            count = merged;
+        }
+        return count == 0 ? nullptr : roots[0];
+    }
+};
+
+#endif
@@ -0,0 +1,908 @@
+// CMSC 341 - Fall 2023 - Project 3
+// Benchmark suite for PQueue.  Not part of the unit tests, build it with
+// optimizations on, e.g.
+// g++ -O2 benchmark.cpp pqueue.cpp patientloader.cpp -o benchmark
+// and keep the CSV or JSON output of each release to compare against.
+
+#include "pqueue.h"
+#include "basicpqueue.h"
+#include "patientloader.h"
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <climits>
+#include <new>
+#include <string>
+#include <iomanip>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+using namespace std;
+
+// Every call to the global operator new is counted, so the benchmark can
+// show how often the hot path still goes to malloc.  With glibc the bytes
+// in use are counted too, as malloc rounded them up.
+long long heapAllocations = 0;
+long long heapBytes = 0; // bytes allocated and not deleted yet, 0 if unknown
+long long blockSize(void* ptr) {
+#ifdef __GLIBC__
+    return (long long)malloc_usable_size(ptr);
+#else
+    return 0;
+#endif
+}
+void* operator new(size_t size) {
+    heapAllocations++;
+    void* ptr = malloc(size ? size : 1);
+    if (ptr == nullptr) {
+        throw bad_alloc();
+    }
+    heapBytes += blockSize(ptr);
+    return ptr;
+}
+void operator delete(void* ptr) noexcept {
+    heapBytes -= blockSize(ptr);
+    free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    heapBytes -= blockSize(ptr);
+    free(ptr);
+}
+
+// Priority functions compute an integer priority for a patient.  Internal
+// computations may be floating point, but must return an integer.
+
+int priorityFn1(const Patient & patient);
+int priorityFn2(const Patient & patient);
+
+// a name database for testing purposes
+const int NUMNAMES = 20;
+string nameDB[NUMNAMES] = {
+    "Ismail Carter", "Lorraine Peters", "Marco Shaffer", "Rebecca Moss",
+    "Lachlan Solomon", "Grace Mclaughlin", "Tyrese Pruitt", "Aiza Green", 
+    "Addie Greer", "Tatiana Buckley", "Tyler Dunn", "Aliyah Strong", 
+    "Alastair Connolly", "Beatrix Acosta", "Camilla Mayo", "Fletcher Beck",
+    "Erika Drake", "Libby Russo", "Liam Taylor", "Sofia Stewart"
+};
+
+// We can use the Random class to generate the test data randomly!
+enum RANDOM {UNIFORMINT, UNIFORMREAL, NORMAL, SHUFFLE};
+class Random {
+public:
+    Random(int min, int max, RANDOM type=UNIFORMINT, int mean=50, int stdev=20) : m_min(min), m_max(max), m_type(type)
+    {
+        if (type == NORMAL){
+            //the case of NORMAL to generate integer numbers with normal distribution
+            m_generator = std::mt19937(m_device());
+            //the data set will have the mean of 50 (default) and standard deviation of 20 (default)
+            //the mean and standard deviation can change by passing new values to constructor 
+            m_normdist = std::normal_distribution<>(mean,stdev);
+        }
+        else if (type == UNIFORMINT) {
+            //the case of UNIFORMINT to generate integer numbers
+            // Using a fixed seed value generates always the same sequence
+            // of pseudorandom numbers, e.g. reproducing scientific experiments
+            // here it helps us with testing since the same sequence repeats
+            m_generator = std::mt19937(10);// 10 is the fixed seed value
+            m_unidist = std::uniform_int_distribution<>(min,max);
+        }
+        else if (type == UNIFORMREAL) { //the case of UNIFORMREAL to generate real numbers
+            m_generator = std::mt19937(10);// 10 is the fixed seed value
+            m_uniReal = std::uniform_real_distribution<double>((double)min,(double)max);
+        }
+        else { //the case of SHUFFLE to generate every number only once
+            m_generator = std::mt19937(m_device());
+        }
+    }
+    void setSeed(int seedNum){
+        // we have set a default value for seed in constructor
+        // we can change the seed by calling this function after constructor call
+        // this gives us more randomness
+        m_generator = std::mt19937(seedNum);
+    }
+
+    void getShuffle(vector<int> & array){
+        // the user program creates the vector param and passes here
+        // here we populate the vector using m_min and m_max
+        for (int i = m_min; i<=m_max; i++){
+            array.push_back(i);
+        }
+        shuffle(array.begin(),array.end(),m_generator);
+    }
+
+    void getShuffle(int array[]){
+        // the param array must be of the size (m_max-m_min+1)
+        // the user program creates the array and pass it here
+        vector<int> temp;
+        for (int i = m_min; i<=m_max; i++){
+            temp.push_back(i);
+        }
+        std::shuffle(temp.begin(), temp.end(), m_generator);
+        vector<int>::iterator it;
+        int i = 0;
+        for (it=temp.begin(); it != temp.end(); it++){
+            array[i] = *it;
+            i++;
+        }
+    }
+
+    int getRandNum(){
+        // this function returns integer numbers
+        // the object must have been initialized to generate integers
+        int result = 0;
+        if(m_type == NORMAL){
+            //returns a random number in a set with normal distribution
+            //we limit random numbers by the min and max values
+            result = m_min - 1;
+            while(result < m_min || result > m_max)
+                result = m_normdist(m_generator);
+        }
+        else if (m_type == UNIFORMINT){
+            //this will generate a random number between min and max values
+            result = m_unidist(m_generator);
+        }
+        return result;
+    }
+
+    double getRealRandNum(){
+        // this function returns real numbers
+        // the object must have been initialized to generate real numbers
+        double result = m_uniReal(m_generator);
+        // a trick to return numbers only with two deciaml points
+        // for example if result is 15.0378, function returns 15.03
+        // to round up we can use ceil function instead of floor
+        result = std::floor(result*100.0)/100.0;
+        return result;
+    }
+    
+    private:
+    int m_min;
+    int m_max;
+    RANDOM m_type;
+    std::random_device m_device;
+    std::mt19937 m_generator;
+    std::normal_distribution<> m_normdist;//normal distribution
+    std::uniform_int_distribution<> m_unidist;//integer uniform distribution
+    std::uniform_real_distribution<double> m_uniReal;//real uniform distribution
+
+};
+
+// returns nanoseconds elapsed since start
+double elapsedNs(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+}
+
+// peak resident set size of the process so far, in kilobytes
+long peakRssKb() {
+#ifdef _WIN32
+    return -1; // not measured on Windows
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // kilobytes on Linux
+#endif
+}
+
+// makes random patients one at a time, so large runs do not have to keep
+// a copy of every patient around
+class PatientSource {
+public:
+    PatientSource() : m_nameGen(0,NUMNAMES-1), m_temperatureGen(MINTEMP,MAXTEMP),
+        m_oxygenGen(MINOX,MAXOX), m_respiratoryGen(MINRR,MAXRR),
+        m_bloodPressureGen(MINBP,MAXBP), m_nurseOpinionGen(MINOPINION,MAXOPINION) {
+        // different seeds, otherwise every vital follows the same sequence
+        m_temperatureGen.setSeed(11);
+        m_oxygenGen.setSeed(12);
+        m_respiratoryGen.setSeed(13);
+        m_bloodPressureGen.setSeed(14);
+        m_nurseOpinionGen.setSeed(15);
+    }
+    Patient next() {
+        return Patient(nameDB[m_nameGen.getRandNum()],
+                    m_temperatureGen.getRandNum(),
+                    m_oxygenGen.getRandNum(),
+                    m_respiratoryGen.getRandNum(),
+                    m_bloodPressureGen.getRandNum(),
+                    m_nurseOpinionGen.getRandNum());
+    }
+private:
+    Random m_nameGen;
+    Random m_temperatureGen;
+    Random m_oxygenGen;
+    Random m_respiratoryGen;
+    Random m_bloodPressureGen;
+    Random m_nurseOpinionGen;
+};
+
+// One row of output.  samples holds the latency of every timed operation
+// in nanoseconds, for whole-queue operations (copy, merge, rebuilds) that
+// is one sample per repetition.
+struct Result {
+    string structure;
+    string heapType;
+    int size;
+    string operation;
+    vector<double> samples;
+    long long allocations; // calls to operator new during the timed part
+    long peakRss;
+};
+
+// returns the value below which the given fraction of samples fall
+double percentile(vector<double> samples, double fraction) {
+    if (samples.empty()) {
+        return 0;
+    }
+    sort(samples.begin(), samples.end());
+    int index = (int)ceil(fraction * samples.size()) - 1;
+    if (index < 0) index = 0;
+    return samples[index];
+}
+
+double mean(const vector<double>& samples) {
+    double total = 0;
+    for (int i = 0; i < (int)samples.size(); i++) {
+        total += samples[i];
+    }
+    return samples.empty() ? 0 : total / samples.size();
+}
+
+const char* structureName(STRUCTURE structure) {
+    switch (structure) {
+        case SKEW: return "SKEW";
+        case LEFTIST: return "LEFTIST";
+        case DARY: return "DARY";
+        default: return "PAIRING";
+    }
+}
+
+void printCsvHeader() {
+    cout << "structure,heaptype,size,operation,ops,ns_per_op,p50_ns,p99_ns,"
+         << "allocs_per_op,peak_rss_kb" << endl;
+}
+
+void printCsv(const Result& result) {
+    int ops = (int)result.samples.size();
+    cout << result.structure << "," << result.heapType << "," << result.size << ","
+         << result.operation << "," << ops << ","
+         << mean(result.samples) << ","
+         << percentile(result.samples, 0.50) << ","
+         << percentile(result.samples, 0.99) << ","
+         << (ops ? (double)result.allocations / ops : 0) << ","
+         << result.peakRss << endl;
+}
+
+// JSON lines, one object per row
+void printJson(const Result& result) {
+    int ops = (int)result.samples.size();
+    cout << "{\"structure\":\"" << result.structure << "\""
+         << ",\"heaptype\":\"" << result.heapType << "\""
+         << ",\"size\":" << result.size
+         << ",\"operation\":\"" << result.operation << "\""
+         << ",\"ops\":" << ops
+         << ",\"ns_per_op\":" << mean(result.samples)
+         << ",\"p50_ns\":" << percentile(result.samples, 0.50)
+         << ",\"p99_ns\":" << percentile(result.samples, 0.99)
+         << ",\"allocs_per_op\":" << (ops ? (double)result.allocations / ops : 0)
+         << ",\"peak_rss_kb\":" << result.peakRss << "}" << endl;
+}
+
+class Suite {
+public:
+    Suite(bool json) : m_json(json) {
+        if (!m_json) {
+            printCsvHeader();
+        }
+    }
+
+    // Runs every operation on a queue of n patients.  MINHEAP runs use
+    // priorityFn2 and MAXHEAP runs use priorityFn1, as in the driver.
+    void run(STRUCTURE structure, HEAPTYPE heapType, int n) {
+        prifn_t priFn = (heapType == MINHEAP) ? priorityFn2 : priorityFn1;
+        prifn_t otherFn = (heapType == MINHEAP) ? priorityFn1 : priorityFn2;
+        HEAPTYPE otherType = (heapType == MINHEAP) ? MAXHEAP : MINHEAP;
+        STRUCTURE otherStructure = (structure == SKEW) ? LEFTIST : SKEW;
+        // whole-queue operations are repeated fewer times on big queues
+        int reps = (n >= 1000000) ? 3 : 10;
+        int ops = (n < 10000) ? n : 10000;
+
+        PatientSource source;
+        PQueue aQueue(priFn, heapType, structure);
+        for (int i = 0; i < n - ops; i++) {
+            aQueue.insertPatient(source.next());
+        }
+
+        // the last ops inserts bring the queue up to n
+        vector<Patient> batch;
+        for (int i = 0; i < ops; i++) {
+            batch.push_back(source.next());
+        }
+        Result insert = start(structure, heapType, n, "insert");
+        for (int i = 0; i < ops; i++) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            aQueue.insertPatient(batch[i]);
+            insert.samples.push_back(elapsedNs(begin));
+        }
+        finish(insert);
+
+        Result extract = start(structure, heapType, n, "extract");
+        for (int i = 0; i < ops; i++) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            batch[i] = aQueue.getNextPatient();
+            extract.samples.push_back(elapsedNs(begin));
+        }
+        finish(extract);
+        for (int i = 0; i < ops; i++) {
+            aQueue.insertPatient(batch[i]);
+        }
+
+        Result copy = start(structure, heapType, n, "copy");
+        for (int i = 0; i < reps; i++) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            PQueue bQueue(aQueue);
+            copy.samples.push_back(elapsedNs(begin));
+        }
+        finish(copy);
+
+        // merges two queues of n / 2 patients
+        Result merge = start(structure, heapType, n, "merge");
+        for (int i = 0; i < reps; i++) {
+            PQueue bQueue(priFn, heapType, structure);
+            PQueue cQueue(priFn, heapType, structure);
+            for (int j = 0; j < n / 2; j++) {
+                bQueue.insertPatient(source.next());
+                cQueue.insertPatient(source.next());
+            }
+            long long allocations = heapAllocations;
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            bQueue.mergeWithQueue(cQueue);
+            merge.samples.push_back(elapsedNs(begin));
+            merge.allocations += heapAllocations - allocations;
+        }
+        finish(merge, false);
+
+        // small ward queues merged into the big one, each followed by one
+        // extraction so the size stays at n
+        Result wardMerge = start(structure, heapType, n, "ward_merge");
+        for (int i = 0; i < ops / 16; i++) {
+            PQueue ward(priFn, heapType, structure);
+            for (int j = 0; j < 16; j++) {
+                ward.insertPatient(batch[(i * 16 + j) % ops]);
+            }
+            long long allocations = heapAllocations;
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            aQueue.mergeWithQueue(ward);
+            wardMerge.samples.push_back(elapsedNs(begin));
+            wardMerge.allocations += heapAllocations - allocations;
+            for (int j = 0; j < 16; j++) {
+                aQueue.getNextPatient();
+            }
+        }
+        finish(wardMerge, false);
+
+        // each sample switches away and the next one switches back
+        Result priority = start(structure, heapType, n, "setPriorityFn");
+        for (int i = 0; i < 2 * reps; i++) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            if (i % 2 == 0) {
+                aQueue.setPriorityFn(otherFn, otherType);
+            }
+            else {
+                aQueue.setPriorityFn(priFn, heapType);
+            }
+            priority.samples.push_back(elapsedNs(begin));
+        }
+        finish(priority);
+
+        Result rebuild = start(structure, heapType, n, "setStructure");
+        for (int i = 0; i < 2 * reps; i++) {
+            chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+            aQueue.setStructure(i % 2 == 0 ? otherStructure : structure);
+            rebuild.samples.push_back(elapsedNs(begin));
+        }
+        finish(rebuild);
+    }
+
+private:
+    bool m_json;
+    long long m_allocations; // operator new calls when the timed part started
+
+    Result start(STRUCTURE structure, HEAPTYPE heapType, int n, const char* operation) {
+        Result result;
+        result.structure = structureName(structure);
+        result.heapType = (heapType == MINHEAP) ? "MINHEAP" : "MAXHEAP";
+        result.size = n;
+        result.operation = operation;
+        result.allocations = 0;
+        result.peakRss = 0;
+        m_allocations = heapAllocations;
+        return result;
+    }
+
+    // countAll is false for operations that counted their own allocations
+    // around the timed calls only
+    void finish(Result& result, bool countAll = true) {
+        if (countAll) {
+            result.allocations = heapAllocations - m_allocations;
+        }
+        result.peakRss = peakRssKb();
+        if (m_json) {
+            printJson(result);
+        }
+        else {
+            printCsv(result);
+        }
+    }
+};
+
+// Fills a queue of each kind with n patients and prints the heap bytes it
+// takes per patient: the nodes or the array, the names that do not fit in
+// the string itself and, the first time, the interned names.
+void runMemory(bool json, int n) {
+    if (!json) {
+        cout << "structure,queue,size,bytes_per_patient,names" << endl;
+    }
+    STRUCTURE structures[] = {SKEW, DARY};
+    for (int s = 0; s < 2; s++) {
+        for (int packed = 0; packed < 2; packed++) {
+            PatientSource source;
+            long long before = heapBytes;
+            int names = 0; // distinct names in the shared table
+            double bytes;
+            if (packed) {
+                PackedPQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+                for (int i = 0; i < n; i++) {
+                    aQueue.insertPatient(source.next());
+                }
+                bytes = (double)(heapBytes - before) / n;
+                names = NameTable::shared().size();
+            }
+            else {
+                PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+                for (int i = 0; i < n; i++) {
+                    aQueue.insertPatient(source.next());
+                }
+                bytes = (double)(heapBytes - before) / n;
+            }
+
+            const char* queue = packed ? "packed" : "patient";
+            if (json) {
+                cout << "{\"structure\":\"" << structureName(structures[s]) << "\""
+                     << ",\"queue\":\"" << queue << "\""
+                     << ",\"size\":" << n
+                     << ",\"bytes_per_patient\":" << bytes
+                     << ",\"names\":" << names << "}" << endl;
+            }
+            else {
+                cout << structureName(structures[s]) << "," << queue << "," << n << ","
+                     << bytes << "," << names << endl;
+            }
+        }
+    }
+}
+
+// Inserts n patients into the queue and takes them all out again, and sets
+// insertNs and extractNs to the average time of each.  An untimed round
+// goes first, so the pool already has its slabs when the timed one starts.
+template <class Queue>
+void timeQueue(Queue& queue, const vector<Patient>& patients, double& insertNs,
+               double& extractNs) {
+    int n = (int)patients.size();
+    for (int i = 0; i < n; i++) {
+        queue.insertPatient(patients[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        queue.getNextPatient();
+    }
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        queue.insertPatient(patients[i]);
+    }
+    insertNs = elapsedNs(begin) / n;
+    begin = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        queue.getNextPatient();
+    }
+    extractNs = elapsedNs(begin) / n;
+}
+
+void printBasic(bool json, STRUCTURE structure, const char* queue, int n,
+                double insertNs, double extractNs) {
+    if (json) {
+        cout << "{\"structure\":\"" << structureName(structure) << "\""
+             << ",\"queue\":\"" << queue << "\""
+             << ",\"size\":" << n
+             << ",\"insert_ns\":" << insertNs
+             << ",\"extract_ns\":" << extractNs << "}" << endl;
+    }
+    else {
+        cout << structureName(structure) << "," << queue << "," << n << ","
+             << insertNs << "," << extractNs << endl;
+    }
+}
+
+// Compares a PQueue with a BasicPQueue of the same structure, both min
+// heaps on priorityFn2 filled with the same n patients
+template <STRUCTURE Structure>
+void runBasic(bool json, const vector<Patient>& patients) {
+    int n = (int)patients.size();
+    double insertNs, extractNs;
+    PQueue aQueue(priorityFn2, MINHEAP, Structure);
+    timeQueue(aQueue, patients, insertNs, extractNs);
+    printBasic(json, Structure, "PQueue", n, insertNs, extractNs);
+    BasicPQueue<PriorityFnOf<priorityFn2>, less<int>, Structure> bQueue;
+    timeQueue(bQueue, patients, insertNs, extractNs);
+    printBasic(json, Structure, "BasicPQueue", n, insertNs, extractNs);
+}
+
+void printScoring(bool json, const char* path, int n, double ns) {
+    if (json) {
+        cout << "{\"path\":\"" << path << "\""
+             << ",\"size\":" << n
+             << ",\"ns_per_patient\":" << ns << "}" << endl;
+    }
+    else {
+        cout << path << "," << n << "," << ns << endl;
+    }
+}
+
+// Scores n patients through the priority function and with scoreBatch at
+// each SIMD level, then times rebuilds with setPriorityFn and with
+// setPriorityPolicy
+void runScoring(bool json, int n) {
+    if (!json) {
+        cout << "path,size,ns_per_patient" << endl;
+    }
+    PatientSource source;
+    vector<Patient> patients;
+    VitalsColumns vitals;
+    for (int i = 0; i < n; i++) {
+        patients.push_back(source.next());
+        vitals.add(patients[i]);
+    }
+    vector<int> keys(n);
+    // priorityFn1 as a policy
+    PriorityPolicy policy1;
+    policy1.setWeight(TEMPERATURE, 1);
+    policy1.setWeight(RESPIRATORY, 1);
+    policy1.setWeight(BLOODPRESSURE, 1);
+
+    // the function pointer is read through a volatile so the compiler can
+    // not inline it, the same as inside the queue
+    prifn_t volatile priFn = priorityFn1;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        keys[i] = priFn(patients[i]);
+    }
+    printScoring(json, "prifn_t", n, elapsedNs(begin) / n);
+
+    const char* names[] = {"scalar", "sse4.1", "avx2"};
+    SIMDLEVEL levels[] = {SCALAR, SSE41, AVX2};
+    for (int l = 0; l < 3 && levels[l] <= bestSimdLevel(); l++) {
+        begin = chrono::steady_clock::now();
+        scoreBatch(policy1, vitals, keys.data(), levels[l]);
+        printScoring(json, names[l], n, elapsedNs(begin) / n);
+    }
+
+    // every rebuild starts from a fresh queue in insertion order, so both
+    // paths walk the nodes the same way
+    STRUCTURE structures[] = {SKEW, DARY};
+    for (int s = 0; s < 2; s++) {
+        for (int batch = 0; batch < 2; batch++) {
+            PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            aQueue.insertPatients(patients.begin(), patients.end());
+            begin = chrono::steady_clock::now();
+            if (batch) {
+                aQueue.setPriorityPolicy(policy1, MAXHEAP);
+            }
+            else {
+                aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+            }
+            string path = (structures[s] == SKEW) ? "SKEW_rebuild" : "DARY_rebuild";
+            printScoring(json, (batch ? path + "_batch" : path).c_str(), n,
+                         elapsedNs(begin) / n);
+        }
+    }
+}
+
+void printSnapshot(bool json, STRUCTURE structure, int n, double insertNs, double saveNs,
+                   double loadNs, double fileBytes) {
+    if (json) {
+        cout << "{\"structure\":\"" << structureName(structure) << "\""
+             << ",\"size\":" << n
+             << ",\"insert_ns\":" << insertNs
+             << ",\"save_ns\":" << saveNs
+             << ",\"load_ns\":" << loadNs
+             << ",\"file_bytes_per_patient\":" << fileBytes << "}" << endl;
+    }
+    else {
+        cout << structureName(structure) << "," << n << "," << insertNs << ","
+             << saveNs << "," << loadNs << "," << fileBytes << endl;
+    }
+}
+
+// Compares filling a queue of n patients one insertPatient at a time, the
+// way a restarted service rebuilds it, with loading a snapshot of it.  All
+// times are per patient.  The file stays in the page cache between saving
+// and loading, so the load is not timed from a cold disk.
+void runSnapshot(bool json, int n) {
+    if (!json) {
+        cout << "structure,size,insert_ns,save_ns,load_ns,file_bytes_per_patient" << endl;
+    }
+    PatientSource source;
+    vector<Patient> patients;
+    for (int i = 0; i < n; i++) {
+        patients.push_back(source.next());
+    }
+    const char* path = "benchmark_snapshot.bin";
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, PAIRING};
+    for (int s = 0; s < 4; s++) {
+        PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+        for (int i = 0; i < n; i++) {
+            aQueue.insertPatient(patients[i]);
+        }
+        double insertNs = elapsedNs(begin) / n;
+
+        begin = chrono::steady_clock::now();
+        aQueue.saveSnapshot(path);
+        double saveNs = elapsedNs(begin) / n;
+        ifstream file(path, ios::binary | ios::ate);
+        double fileBytes = (double)file.tellg() / n;
+
+        PQueue bQueue(priorityFn2, MINHEAP, structures[s]);
+        begin = chrono::steady_clock::now();
+        bQueue.loadSnapshot(path);
+        double loadNs = elapsedNs(begin) / n;
+        printSnapshot(json, structures[s], n, insertNs, saveNs, loadNs, fileBytes);
+    }
+    remove(path);
+}
+
+void printIngest(bool json, const char* loader, int n, double bytes, double ns) {
+    double mbPerSecond = (ns > 0) ? bytes / n * 1000.0 / ns : 0;
+    if (json) {
+        cout << "{\"loader\":\"" << loader << "\""
+             << ",\"size\":" << n
+             << ",\"bytes_per_patient\":" << bytes / n
+             << ",\"load_ns\":" << ns
+             << ",\"mb_per_s\":" << mbPerSecond << "}" << endl;
+    }
+    else {
+        cout << loader << "," << n << "," << bytes / n << "," << ns << "," << mbPerSecond << endl;
+    }
+}
+
+// Loads n patients from a CSV file with getline and a stringstream per
+// line, the way a quick importer would, then with PatientLoader from the
+// same CSV file and from a binary one.  All three insert batches of 4096
+// patients, so the times differ by the parsing.  Times are per patient and
+// include inserting into the queue.  The files stay in the page cache.
+void runIngest(bool json, int n) {
+    if (!json) {
+        cout << "loader,size,bytes_per_patient,load_ns,mb_per_s" << endl;
+    }
+    PatientSource source;
+    vector<Patient> patients;
+    for (int i = 0; i < n; i++) {
+        patients.push_back(source.next());
+    }
+    const char* csvPath = "benchmark_patients.csv";
+    const char* binaryPath = "benchmark_patients.bin";
+    {
+        ofstream file(csvPath);
+        for (int i = 0; i < n; i++) {
+            file << patients[i].getPatient() << "," << patients[i].getTemperature() << ","
+                 << patients[i].getOxygen() << "," << patients[i].getRR() << ","
+                 << patients[i].getBP() << "," << patients[i].getOpinion() << "\n";
+        }
+    }
+    PatientLoader::saveBinary(binaryPath, patients);
+
+    PQueue aQueue(priorityFn2, MINHEAP, SKEW);
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    ifstream file(csvPath);
+    string line;
+    vector<Patient> batch;
+    long long bytes = 0;
+    while (getline(file, line)) {
+        bytes += line.size() + 1;
+        stringstream fields(line);
+        string name, temperature, oxygen, respiratory, bloodPressure, opinion;
+        getline(fields, name, ',');
+        getline(fields, temperature, ',');
+        getline(fields, oxygen, ',');
+        getline(fields, respiratory, ',');
+        getline(fields, bloodPressure, ',');
+        getline(fields, opinion, ',');
+        batch.push_back(Patient(name, stoi(temperature), stoi(oxygen), stoi(respiratory),
+                                stoi(bloodPressure), stoi(opinion)));
+        if (batch.size() == 4096) {
+            aQueue.insertPatients(make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+            batch.clear();
+        }
+    }
+    aQueue.insertPatients(make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+    printIngest(json, "getline", n, (double)bytes, elapsedNs(begin) / n);
+
+    PQueue bQueue(priorityFn2, MINHEAP, SKEW);
+    PatientLoader csvLoader(PatientLoader::CSV);
+    begin = chrono::steady_clock::now();
+    csvLoader.load(csvPath, bQueue);
+    printIngest(json, "csv", n, (double)csvLoader.numBytes(), elapsedNs(begin) / n);
+
+    PQueue cQueue(priorityFn2, MINHEAP, SKEW);
+    PatientLoader binaryLoader(PatientLoader::BINARY);
+    begin = chrono::steady_clock::now();
+    binaryLoader.load(binaryPath, cQueue);
+    printIngest(json, "binary", n, (double)binaryLoader.numBytes(), elapsedNs(begin) / n);
+    remove(csvPath);
+    remove(binaryPath);
+}
+
+void printUsage() {
+    cerr << "Usage: benchmark [--format csv|json] [--min-size N] [--max-size N]" << endl
+         << "                 [--memory N] [--basic N] [--scoring N] [--snapshot N]" << endl
+         << "                 [--ingest N]" << endl;
+}
+
+// Reads a size that is a whole number of at least 0, returns -1 otherwise
+int parseSize(const char* text) {
+    char* end;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0 || value > INT_MAX) {
+        return -1;
+    }
+    return (int)value;
+}
+
+// Usage: benchmark [--format csv|json] [--min-size N] [--max-size N]
+//                  [--memory N] [--basic N] [--scoring N] [--snapshot N]
+//                  [--ingest N]
+// Sizes go up by a factor of 10 from the min size (default 1000) to the
+// max size (default 10000000).  --memory only compares the memory a PQueue
+// and a PackedPQueue of N patients take, --basic only compares PQueue and
+// BasicPQueue on N patients, --scoring only compares the ways to score
+// N patients, --snapshot only compares inserting N patients with
+// loading a snapshot of them and --ingest only compares the ways to load
+// N patients from a file.  The output goes to stdout.  An unknown option,
+// an option without a value or a bad value prints the usage and exits
+// with 1.
+int main(int argc, char* argv[]){
+    bool json = false;
+    int minSize = 1000;
+    int maxSize = 10000000;
+    int memorySize = 0;
+    int basicSize = 0;
+    int scoringSize = 0;
+    int snapshotSize = 0;
+    int ingestSize = 0;
+    for (int i = 1; i < argc; i += 2) {
+        string option = argv[i];
+        int* size = nullptr;
+        if (option == "--min-size") {
+            size = &minSize;
+        }
+        else if (option == "--max-size") {
+            size = &maxSize;
+        }
+        else if (option == "--memory") {
+            size = &memorySize;
+        }
+        else if (option == "--basic") {
+            size = &basicSize;
+        }
+        else if (option == "--scoring") {
+            size = &scoringSize;
+        }
+        else if (option == "--snapshot") {
+            size = &snapshotSize;
+        }
+        else if (option == "--ingest") {
+            size = &ingestSize;
+        }
+        else if (option != "--format") {
+            cerr << "Unknown option " << option << endl;
+            printUsage();
+            return 1;
+        }
+        if (i + 1 == argc) {
+            cerr << "Missing value for " << option << endl;
+            printUsage();
+            return 1;
+        }
+
+        string value = argv[i + 1];
+        if (size == nullptr) {
+            if (value != "csv" && value != "json") {
+                cerr << "Unknown format " << value << endl;
+                printUsage();
+                return 1;
+            }
+            json = (value == "json");
+        }
+        else {
+            *size = parseSize(value.c_str());
+            if (*size < 0) {
+                cerr << "Bad size " << value << " for " << option << endl;
+                printUsage();
+                return 1;
+            }
+        }
+    }
+
+    cout << fixed << setprecision(3);
+    if (memorySize > 0) {
+        runMemory(json, memorySize);
+        return 0;
+    }
+    if (scoringSize > 0) {
+        runScoring(json, scoringSize);
+        return 0;
+    }
+    if (snapshotSize > 0) {
+        runSnapshot(json, snapshotSize);
+        return 0;
+    }
+    if (ingestSize > 0) {
+        runIngest(json, ingestSize);
+        return 0;
+    }
+    if (basicSize > 0) {
+        if (!json) {
+            cout << "structure,queue,size,insert_ns,extract_ns" << endl;
+        }
+        PatientSource source;
+        vector<Patient> patients;
+        for (int i = 0; i < basicSize; i++) {
+            patients.push_back(source.next());
+        }
+        runBasic<SKEW>(json, patients);
+        runBasic<LEFTIST>(json, patients);
+        runBasic<PAIRING>(json, patients);
+        return 0;
+    }
+    STRUCTURE structures[] = {SKEW, LEFTIST, DARY, PAIRING};
+    HEAPTYPE heapTypes[] = {MINHEAP, MAXHEAP};
+    Suite suite(json);
+    for (long long n = minSize; n <= maxSize; n *= 10) {
+        for (int s = 0; s < 4; s++) {
+            for (int h = 0; h < 2; h++) {
+                suite.run(structures[s], heapTypes[h], (int)n);
+            }
+        }
+    }
+    return 0;
+}
+
+int priorityFn1(const Patient & patient) {
+    //this function works with a MAXHEAP
+    //priority value is determined based on some criteria
+    //priority value falls in the range [115-242]
+    //temperature + respiratory + blood pressure
+    //the highest priority would be 42+40+160 = 242
+    //the lowest priority would be 35+10+70 = 115
+    //the larger value means the higher priority
+    int priority = patient.getTemperature() + patient.getRR() + patient.getBP();
+    return priority;
+}
+
+int priorityFn2(const Patient & patient) {
+    //this function works with a MINHEAP
+    //priority value is determined based on some criteria
+    //priority value falls in the range [71-111]
+    //nurse opinion + oxygen
+    //the highest priority would be 1+70 = 71
+    //the lowest priority would be 10+101 = 111
+    //the smaller value means the higher priority
+    int priority = patient.getOpinion() + patient.getOxygen();
+    return priority;
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+// CMSC 341 - Fall 2023 - Project 3
+// Thread scaling benchmark for ConcurrentPQueue.  Not part of the unit
+// tests, build it with optimizations on, e.g.
+// g++ -O2 -pthread concurrentbenchmark.cpp pqueue.cpp concurrentpqueue.cpp -o concurrentbenchmark
+// Every thread alternates inserting a patient and removing the next one,
+// on a queue that starts with a fixed number of patients.  Three queues are
+// compared: a PQueue behind one global mutex (what callers do without
+// ConcurrentPQueue), the relaxed MultiQueue and the strict one.
+
+#include "pqueue.h"
+#include "concurrentpqueue.h"
+#include <random>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <cstdlib>
+#include <string>
+#include <iomanip>
+using namespace std;
+
+int priorityFn2(const Patient & patient);
+
+// random patients made up front, so generating them is not timed
+vector<Patient> makePatients(int count, int seed) {
+    mt19937 generator(seed);
+    uniform_int_distribution<> temperature(MINTEMP, MAXTEMP);
+    uniform_int_distribution<> oxygen(MINOX, MAXOX);
+    uniform_int_distribution<> respiratory(MINRR, MAXRR);
+    uniform_int_distribution<> bloodPressure(MINBP, MAXBP);
+    uniform_int_distribution<> opinion(MINOPINION, MAXOPINION);
+    vector<Patient> patients;
+    for (int i = 0; i < count; i++) {
+        patients.push_back(Patient("Patient " + to_string(i),
+                                   temperature(generator), oxygen(generator),
+                                   respiratory(generator), bloodPressure(generator),
+                                   opinion(generator)));
+    }
+    return patients;
+}
+
+// the baseline, one PQueue that every thread locks as a whole
+class LockedPQueue {
+public:
+    LockedPQueue() : m_queue(priorityFn2, MINHEAP, SKEW) {}
+    void insertPatient(const Patient& patient) {
+        lock_guard<mutex> guard(m_lock);
+        m_queue.insertPatient(patient);
+    }
+    bool tryGetNextPatient(Patient& patient) {
+        lock_guard<mutex> guard(m_lock);
+        if (m_queue.numPatients() == 0) {
+            return false;
+        }
+        patient = m_queue.getNextPatient();
+        return true;
+    }
+private:
+    mutex m_lock;
+    PQueue m_queue;
+};
+
+// Fills the queue with prefill patients, then times threads threads doing
+// opsPerThread insert and remove pairs each.  Returns nanoseconds per
+// operation, counting an insert and a remove as two operations.
+template <class Queue>
+double runThreads(Queue& queue, int threads, int opsPerThread,
+                  const vector<Patient>& prefill, const vector<vector<Patient>>& work) {
+    for (int i = 0; i < (int)prefill.size(); i++) {
+        queue.insertPatient(prefill[i]);
+    }
+
+    vector<thread> workers;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&queue, &work, t, opsPerThread]() {
+            const vector<Patient>& patients = work[t];
+            Patient patient;
+            for (int i = 0; i < opsPerThread; i++) {
+                queue.insertPatient(patients[i]);
+                queue.tryGetNextPatient(patient);
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+    return elapsed / (2.0 * threads * opsPerThread);
+}
+
+void printRow(bool json, const char* queue, int threads, int shards, int ops, double nsPerOp) {
+    double mops = (nsPerOp > 0) ? 1000.0 / nsPerOp : 0;
+    if (json) {
+        cout << "{\"queue\":\"" << queue << "\""
+             << ",\"threads\":" << threads
+             << ",\"shards\":" << shards
+             << ",\"ops\":" << ops
+             << ",\"ns_per_op\":" << nsPerOp
+             << ",\"mops_per_s\":" << mops << "}" << endl;
+    }
+    else {
+        cout << queue << "," << threads << "," << shards << "," << ops << ","
+             << nsPerOp << "," << mops << endl;
+    }
+}
+
+// Usage: concurrentbenchmark [--format csv|json] [--max-threads N]
+//                            [--ops N] [--prefill N]
+// Threads go up by a factor of 2 from 1 to the max (default 64).  ops is
+// the number of insert and remove pairs per thread (default 100000) and
+// prefill the number of patients queued before the threads start (default
+// 100000).  The relaxed queue compares 2 shards per removal.
+int main(int argc, char* argv[]){
+    bool json = false;
+    int maxThreads = 64;
+    int opsPerThread = 100000;
+    int prefillSize = 100000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--format") {
+            json = (string(argv[i + 1]) == "json");
+        }
+        else if (option == "--max-threads") {
+            maxThreads = atoi(argv[i + 1]);
+        }
+        else if (option == "--ops") {
+            opsPerThread = atoi(argv[i + 1]);
+        }
+        else if (option == "--prefill") {
+            prefillSize = atoi(argv[i + 1]);
+        }
+        else {
+            cerr << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+
+    cout << fixed << setprecision(3);
+    if (!json) {
+        cout << "queue,threads,shards,ops,ns_per_op,mops_per_s" << endl;
+    }
+    vector<Patient> prefill = makePatients(prefillSize, 1);
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        vector<vector<Patient>> work;
+        for (int t = 0; t < threads; t++) {
+            work.push_back(makePatients(opsPerThread, t + 2));
+        }
+        int ops = 2 * threads * opsPerThread;
+        int shards = 2 * threads;
+
+        LockedPQueue locked;
+        printRow(json, "mutex", threads, 1, ops,
+                 runThreads(locked, threads, opsPerThread, prefill, work));
+
+        ConcurrentPQueue relaxed(priorityFn2, MINHEAP, SKEW, shards, 2);
+        printRow(json, "multiqueue", threads, shards, ops,
+                 runThreads(relaxed, threads, opsPerThread, prefill, work));
+
+        ConcurrentPQueue strict(priorityFn2, MINHEAP, SKEW, shards, STRICT);
+        printRow(json, "strict", threads, shards, ops,
+                 runThreads(strict, threads, opsPerThread, prefill, work));
+    }
+    return 0;
+}
+
+int priorityFn2(const Patient & patient) {
+    //this function works with a MINHEAP
+    //priority value is determined based on some criteria
+    //priority value falls in the range [71-111]
+    //nurse opinion + oxygen
+    //the highest priority would be 1+70 = 71
+    //the lowest priority would be 10+101 = 111
+    //the smaller value means the higher priority
+    int priority = patient.getOpinion() + patient.getOxygen();
+    return priority;
+}
@@ -0,0 +1,274 @@
+// CMSC 341 - Fall 2023 - Project 3
+#include "concurrentpqueue.h"
+#include <thread>
+#include <functional>
+
+ConcurrentPQueue::ConcurrentPQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure,
+                                   int shards, int strictness) {
+    if (shards < 0) {
+        throw out_of_range("The number of shards can not be negative");
+    }
+    if (strictness < 0) {
+        throw out_of_range("The strictness can not be negative");
+    }
+    if (shards == 0) {
+        // hardware_concurrency may not know and return 0
+        shards = 2 * (int)thread::hardware_concurrency();
+        if (shards < 2) {
+            shards = 2;
+        }
+    }
+
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_structure = structure;
+    m_size = 0;
+    m_strictness = strictness;
+    for (int i = 0; i < shards; i++) {
+        m_shards.push_back(unique_ptr<Shard>(new Shard(priFn, heapType, structure)));
+    }
+}
+
+// the shards free their own nodes
+ConcurrentPQueue::~ConcurrentPQueue() {
+}
+
+void ConcurrentPQueue::insertPatient(const Patient& input) {
+    Shard* shard = lockShard();
+    lock_guard<mutex> guard(shard->m_lock, adopt_lock);
+    shard->m_queue.insertPatient(input);
+    publish(*shard);
+}
+
+void ConcurrentPQueue::insertPatient(Patient&& input) {
+    Shard* shard = lockShard();
+    lock_guard<mutex> guard(shard->m_lock, adopt_lock);
+    shard->m_queue.insertPatient(std::move(input));
+    publish(*shard);
+}
+
+Patient ConcurrentPQueue::getNextPatient() {
+    Patient patient;
+    if (!tryGetNextPatient(patient)) {
+        throw out_of_range("The heap is empty");
+    }
+    return patient;
+}
+
+bool ConcurrentPQueue::tryGetNextPatient(Patient& patient) {
+    int strictness = m_strictness;
+    if (strictness == STRICT || strictness >= (int)m_shards.size()) {
+        return removeStrict(patient);
+    }
+    return removeRelaxed(patient);
+}
+
+void ConcurrentPQueue::mergeWithQueue(PQueue& rhs) {
+    if (rhs.m_priorFunc != m_priorFunc || rhs.m_heapType != m_heapType ||
+        rhs.m_structure != m_structure) {
+        throw domain_error("Different priority function or structure");
+    }
+
+    Shard* shard = lockShard();
+    lock_guard<mutex> guard(shard->m_lock, adopt_lock);
+    shard->m_queue.mergeWithQueue(rhs);
+    publish(*shard);
+}
+
+// the shards are melded one by one into the result, which takes over
+// their nodes without copying the patients
+PQueue ConcurrentPQueue::mergeShards() {
+    PQueue result(m_priorFunc, m_heapType, m_structure);
+    AllShardsLock guard(*this);
+    for (int i = 0; i < (int)m_shards.size(); i++) {
+        result.mergeWithQueue(m_shards[i]->m_queue);
+        publish(*m_shards[i]);
+    }
+    return result;
+}
+
+void ConcurrentPQueue::clear() {
+    AllShardsLock guard(*this);
+    for (int i = 0; i < (int)m_shards.size(); i++) {
+        m_shards[i]->m_queue.clear();
+        publish(*m_shards[i]);
+    }
+}
+
+int ConcurrentPQueue::numPatients() const {
+    return m_size;
+}
+
+int ConcurrentPQueue::numShards() const {
+    return (int)m_shards.size();
+}
+
+int ConcurrentPQueue::getStrictness() const {
+    return m_strictness;
+}
+
+void ConcurrentPQueue::setStrictness(int strictness) {
+    if (strictness < 0) {
+        throw out_of_range("The strictness can not be negative");
+    }
+    m_strictness = strictness;
+}
+
+prifn_t ConcurrentPQueue::getPriorityFn() const {
+    return m_priorFunc;
+}
+
+HEAPTYPE ConcurrentPQueue::getHeapType() const {
+    return m_heapType;
+}
+
+STRUCTURE ConcurrentPQueue::getStructure() const {
+    return m_structure;
+}
+
+// xorshift, with one state per thread so picking a shard never contends
+int ConcurrentPQueue::randomShard() const {
+    static thread_local unsigned int state = 0;
+    if (state == 0) {
+        state = (unsigned int)hash<thread::id>()(this_thread::get_id()) | 1;
+    }
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (int)(state % m_shards.size());
+}
+
+// tries a few random shards for one that is not locked, and waits on the
+// last one tried if they are all busy
+ConcurrentPQueue::Shard* ConcurrentPQueue::lockShard() {
+    Shard* shard = nullptr;
+    for (int i = 0; i < (int)m_shards.size(); i++) {
+        shard = m_shards[randomShard()].get();
+        if (shard->m_lock.try_lock()) {
+            return shard;
+        }
+    }
+    shard->m_lock.lock();
+    return shard;
+}
+
+// always in index order, so two threads locking every shard can not
+// deadlock.  If a lock throws the shards locked so far are unlocked.
+void ConcurrentPQueue::lockAll() {
+    int locked = 0;
+    try {
+        for (; locked < (int)m_shards.size(); locked++) {
+            m_shards[locked]->m_lock.lock();
+        }
+    }
+    catch (...) {
+        for (int i = locked - 1; i >= 0; i--) {
+            m_shards[i]->m_lock.unlock();
+        }
+        throw;
+    }
+}
+
+void ConcurrentPQueue::unlockAll() {
+    for (int i = (int)m_shards.size() - 1; i >= 0; i--) {
+        m_shards[i]->m_lock.unlock();
+    }
+}
+
+// Updates the count and top key other threads read without the lock, and
+// the total size.  Must be called with the lock of the shard held.
+void ConcurrentPQueue::publish(Shard& shard) {
+    int count = shard.m_queue.numPatients();
+    if (count > 0) {
+        shard.m_top = topKey(shard.m_queue);
+    }
+    int change = count - shard.m_count;
+    shard.m_count = count;
+    m_size += change;
+}
+
+// queue must not be empty
+int ConcurrentPQueue::topKey(const PQueue& queue) const {
+    if (queue.m_structure == DARY) {
+        return queue.m_entries[0].m_key;
+    }
+    return queue.m_heap->getKey();
+}
+
+bool ConcurrentPQueue::higherKey(int key1, int key2) const {
+    if (m_heapType == MINHEAP) {
+        return key1 < key2;
+    }
+    return key1 > key2;
+}
+
+// Compares the published tops of strictness random shards and removes the
+// best of them.  The tops may change before the shard is locked, that only
+// makes the choice a little less accurate.
+bool ConcurrentPQueue::removeRelaxed(Patient& patient) {
+    int shards = (int)m_shards.size();
+    int strictness = m_strictness;
+    while (m_size > 0) {
+        int best = -1;
+        int bestKey = 0;
+        for (int i = 0; i < strictness; i++) {
+            int index = randomShard();
+            Shard& shard = *m_shards[index];
+            if (shard.m_count > 0) {
+                int key = shard.m_top;
+                if (best == -1 || higherKey(key, bestKey)) {
+                    best = index;
+                    bestKey = key;
+                }
+            }
+        }
+
+        // every sampled shard was empty, take any shard that is not
+        if (best == -1) {
+            int start = randomShard();
+            for (int i = 0; i < shards && best == -1; i++) {
+                if (m_shards[(start + i) % shards]->m_count > 0) {
+                    best = (start + i) % shards;
+                }
+            }
+            if (best == -1) {
+                // another thread is between changing a shard and m_size
+                this_thread::yield();
+                continue;
+            }
+        }
+
+        Shard& shard = *m_shards[best];
+        lock_guard<mutex> guard(shard.m_lock);
+        if (shard.m_queue.numPatients() > 0) {
+            patient = shard.m_queue.getNextPatient();
+            publish(shard);
+            return true;
+        }
+        // emptied by another thread since it was sampled, try again
+    }
+    return false;
+}
+
+// locks every shard so the best patient of all of them is removed
+bool ConcurrentPQueue::removeStrict(Patient& patient) {
+    AllShardsLock guard(*this);
+    int best = -1;
+    int bestKey = 0;
+    for (int i = 0; i < (int)m_shards.size(); i++) {
+        const PQueue& queue = m_shards[i]->m_queue;
+        if (queue.numPatients() > 0) {
+            int key = topKey(queue);
+            if (best == -1 || higherKey(key, bestKey)) {
+                best = i;
+                bestKey = key;
+            }
+        }
+    }
+
+    if (best != -1) {
+        patient = m_shards[best]->m_queue.getNextPatient();
+        publish(*m_shards[best]);
+    }
+    return best != -1;
+}
@@ -0,0 +1,96 @@
+// CMSC 341 - Fall 2023 - Project 3
+#ifndef CONCURRENTPQUEUE_H
+#define CONCURRENTPQUEUE_H
+
+#include "pqueue.h"
+#include <atomic>
+#include <mutex>
+#include <memory>
+using namespace std;
+
+// strictness that makes getNextPatient compare every shard
+const int STRICT = 0;
+
+class ConcurrentPQueue {
+    // Thread safe priority queue for many intake threads and many clinician
+    // threads (a MultiQueue).  Patients are spread over several shards, each
+    // an ordinary PQueue behind its own mutex, so threads that work on
+    // different shards never wait for each other.  insertPatient puts the
+    // patient in a random shard that is not locked.  getNextPatient looks at
+    // the top of strictness random shards without locking them and removes
+    // the best of those, so it returns a patient close to, but not always,
+    // the highest priority one.  With STRICT every shard is locked and the
+    // result is exactly what a single PQueue would return.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    // shards of 0 makes two shards per hardware thread
+    ConcurrentPQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure,
+                     int shards = 0, int strictness = 2);
+    ~ConcurrentPQueue();
+    void insertPatient(const Patient& input);
+    void insertPatient(Patient&& input);
+    // Throws out_of_range if no patient is queued
+    Patient getNextPatient();
+    // Same as getNextPatient, but returns false if no patient is queued
+    bool tryGetNextPatient(Patient& patient);
+    // Moves the patients of rhs into one shard, rhs must have the same
+    // priority function and structure
+    void mergeWithQueue(PQueue& rhs);
+    // Moves every queued patient into a single PQueue and returns it
+    PQueue mergeShards();
+    void clear();
+    int numPatients() const; // may be stale while other threads are working
+    int numShards() const;
+    int getStrictness() const;
+    // Number of shards getNextPatient compares, STRICT for all of them
+    void setStrictness(int strictness);
+    prifn_t getPriorityFn() const;
+    HEAPTYPE getHeapType() const;
+    STRUCTURE getStructure() const;
+
+private:
+    // every shard is on its own cache lines, so locking one does not slow
+    // down threads working on its neighbours
+    struct alignas(64) Shard {
+        Shard(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure)
+            : m_queue(priFn, heapType, structure), m_count(0), m_top(0) {}
+        mutex m_lock;          // guards m_queue
+        PQueue m_queue;
+        atomic<int> m_count;   // patients in m_queue, read without the lock
+        atomic<int> m_top;     // key of the top patient if m_count > 0
+    };
+
+    // holds every shard lock from construction to destruction, so an
+    // exception can not leave the shards locked
+    class AllShardsLock {
+    public:
+        explicit AllShardsLock(ConcurrentPQueue& queue) : m_queue(queue) {m_queue.lockAll();}
+        ~AllShardsLock() {m_queue.unlockAll();}
+    private:
+        ConcurrentPQueue& m_queue;
+        AllShardsLock(const AllShardsLock& rhs);            // not copyable
+        AllShardsLock& operator=(const AllShardsLock& rhs); // not copyable
+    };
+
+    vector<unique_ptr<Shard>> m_shards;
+    atomic<int> m_size;        // patients in all shards
+    atomic<int> m_strictness;
+    prifn_t m_priorFunc;
+    HEAPTYPE m_heapType;
+    STRUCTURE m_structure;
+
+    ConcurrentPQueue(const ConcurrentPQueue& rhs);            // not copyable
+    ConcurrentPQueue& operator=(const ConcurrentPQueue& rhs); // not copyable
+    int randomShard() const;
+    Shard* lockShard(); // the caller takes over the lock with adopt_lock
+    void lockAll();     // through AllShardsLock
+    void unlockAll();
+    void publish(Shard& shard);
+    int topKey(const PQueue& queue) const;
+    bool higherKey(int key1, int key2) const;
+    bool removeRelaxed(Patient& patient);
+    bool removeStrict(Patient& patient);
+};
+
+#endif
@@ -0,0 +1,153 @@
+// CMSC 341 - Fall 2023 - Project 3
+// Group commit benchmark for JournaledPQueue.  Not part of the unit tests,
+// build it with optimizations on, e.g.
+// g++ -O2 -pthread journalbenchmark.cpp pqueue.cpp journaledpqueue.cpp -o journalbenchmark
+// Every thread alternates inserting a patient and removing the next one,
+// and the timer stops once every record is on disk.  Each row is one batch
+// size and commit window, so the rows show how many fsyncs group commit
+// saves and what it costs per operation.  The journal files are made in
+// the current directory and removed afterwards.
+
+#include "pqueue.h"
+#include "journaledpqueue.h"
+#include <random>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <iomanip>
+using namespace std;
+
+int priorityFn2(const Patient & patient);
+
+const char* SNAPSHOTFILE = "journalbenchmark_snapshot.bin";
+const char* JOURNALFILE = "journalbenchmark_journal.bin";
+
+// random patients made up front, so generating them is not timed
+vector<Patient> makePatients(int count, int seed) {
+    mt19937 generator(seed);
+    uniform_int_distribution<> temperature(MINTEMP, MAXTEMP);
+    uniform_int_distribution<> oxygen(MINOX, MAXOX);
+    uniform_int_distribution<> respiratory(MINRR, MAXRR);
+    uniform_int_distribution<> bloodPressure(MINBP, MAXBP);
+    uniform_int_distribution<> opinion(MINOPINION, MAXOPINION);
+    vector<Patient> patients;
+    for (int i = 0; i < count; i++) {
+        patients.push_back(Patient("Patient " + to_string(i),
+                                   temperature(generator), oxygen(generator),
+                                   respiratory(generator), bloodPressure(generator),
+                                   opinion(generator)));
+    }
+    return patients;
+}
+
+// Times threads threads doing opsPerThread insert and remove pairs each,
+// plus the sync that makes them durable.  Returns nanoseconds per
+// operation, counting an insert and a remove as two operations.
+double runThreads(JournaledPQueue& queue, int threads, int opsPerThread,
+                  const vector<vector<Patient>>& work) {
+    vector<thread> workers;
+    chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(thread([&queue, &work, t, opsPerThread]() {
+            const vector<Patient>& patients = work[t];
+            for (int i = 0; i < opsPerThread; i++) {
+                queue.insertPatient(patients[i]);
+                queue.getNextPatient();
+            }
+        }));
+    }
+    for (int t = 0; t < threads; t++) {
+        workers[t].join();
+    }
+    queue.sync();
+    double elapsed = chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count();
+    return elapsed / (2.0 * threads * opsPerThread);
+}
+
+void printRow(bool json, int batch, int window, int threads, int ops,
+              double nsPerOp, int syncs) {
+    double opsPerSecond = (nsPerOp > 0) ? 1e9 / nsPerOp : 0;
+    double recordsPerSync = (syncs > 0) ? (double)ops / syncs : 0;
+    if (json) {
+        cout << "{\"batch\":" << batch
+             << ",\"window_us\":" << window
+             << ",\"threads\":" << threads
+             << ",\"ops\":" << ops
+             << ",\"ns_per_op\":" << nsPerOp
+             << ",\"ops_per_s\":" << opsPerSecond
+             << ",\"syncs\":" << syncs
+             << ",\"records_per_sync\":" << recordsPerSync << "}" << endl;
+    }
+    else {
+        cout << batch << "," << window << "," << threads << "," << ops << ","
+             << nsPerOp << "," << opsPerSecond << "," << syncs << ","
+             << recordsPerSync << endl;
+    }
+}
+
+// Usage: journalbenchmark [--format csv|json] [--threads N] [--ops N]
+// threads is the number of threads sharing the queue (default 4) and ops
+// the number of insert and remove pairs per thread (default 2000).  The
+// batch sizes are 1, 8, 64 and 512 and the windows 0, 1000 and 10000
+// microseconds, where 0 only commits full batches.
+int main(int argc, char* argv[]){
+    bool json = false;
+    int threads = 4;
+    int opsPerThread = 2000;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string option = argv[i];
+        if (option == "--format") {
+            json = (string(argv[i + 1]) == "json");
+        }
+        else if (option == "--threads") {
+            threads = atoi(argv[i + 1]);
+        }
+        else if (option == "--ops") {
+            opsPerThread = atoi(argv[i + 1]);
+        }
+        else {
+            cerr << "Unknown option " << option << endl;
+            return 1;
+        }
+    }
+
+    cout << fixed << setprecision(3);
+    if (!json) {
+        cout << "batch,window_us,threads,ops,ns_per_op,ops_per_s,syncs,records_per_sync" << endl;
+    }
+    vector<vector<Patient>> work;
+    for (int t = 0; t < threads; t++) {
+        work.push_back(makePatients(opsPerThread, t + 1));
+    }
+    int ops = 2 * threads * opsPerThread;
+    const int batches[] = {1, 8, 64, 512};
+    const int windows[] = {0, 1000, 10000};
+    for (int batch : batches) {
+        for (int window : windows) {
+            remove(SNAPSHOTFILE);
+            remove(JOURNALFILE);
+            JournaledPQueue queue(priorityFn2, MINHEAP, SKEW, SNAPSHOTFILE, JOURNALFILE,
+                                  batch, window);
+            double nsPerOp = runThreads(queue, threads, opsPerThread, work);
+            printRow(json, batch, window, threads, ops, nsPerOp, queue.numSyncs());
+        }
+    }
+    remove(SNAPSHOTFILE);
+    remove(JOURNALFILE);
+    return 0;
+}
+
+int priorityFn2(const Patient & patient) {
+    //this function works with a MINHEAP
+    //priority value is determined based on some criteria
+    //priority value falls in the range [71-111]
+    //nurse opinion + oxygen
+    //the highest priority would be 1+70 = 71
+    //the lowest priority would be 10+101 = 111
+    //the smaller value means the higher priority
+    int priority = patient.getOpinion() + patient.getOxygen();
+    return priority;
+}
@@ -0,0 +1,615 @@
+// CMSC 341 - Fall 2023 - Project 3
+#include "journaledpqueue.h"
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Journal files hold every number in the byte order of the machine that
+// wrote them:
+//   "PQJL", uint32 version, uint32 0x01020304 (shows the byte order)
+//   uint64 FNV-1a hash of the snapshot the journal goes on top of
+//   the records, each one
+//     uint8 type, uint32 length of the payload, the payload
+//     uint32 FNV-1a hash of the type, the length and the payload
+// INSERT holds a patient, REMOVE the int32 key of the patient removed so
+// the replay can check it, MERGE a uint32 count and that many patients and
+// CLEAR nothing.  A patient is int32 temperature, oxygen, RR, BP and
+// opinion, then the uint32 length of the name and the name.
+const uint32_t JOURNALVERSION = 1;
+const uint32_t JOURNALORDER = 0x01020304;
+const size_t JOURNALHEADER = 20;
+const size_t RECORDOVERHEAD = 9; // type, length and hash
+
+static uint32_t hash32(const char* data, size_t count) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < count; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// FNV-1a over the whole file
+static uint64_t hashFile(const string& path) {
+    uint64_t hash = 14695981039346656037ull;
+    ifstream file(path.c_str(), ios::binary);
+    char chunk[65536];
+    while (file) {
+        file.read(chunk, sizeof(chunk));
+        streamsize count = file.gcount();
+        for (streamsize i = 0; i < count; i++) {
+            hash = (hash ^ (unsigned char)chunk[i]) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+static void putInt(string& out, uint32_t value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+static void putPatient(string& out, const Patient& patient) {
+    putInt(out, patient.getTemperature());
+    putInt(out, patient.getOxygen());
+    putInt(out, patient.getRR());
+    putInt(out, patient.getBP());
+    putInt(out, patient.getOpinion());
+    const string& name = patient.getPatient();
+    putInt(out, (uint32_t)name.size());
+    out += name;
+}
+
+static uint32_t getInt(const string& data, size_t& pos, size_t end) {
+    if (pos > end || end - pos < sizeof(uint32_t)) {
+        throw domain_error("The journal is damaged");
+    }
+    uint32_t value;
+    memcpy(&value, data.data() + pos, sizeof(value));
+    pos += sizeof(value);
+    return value;
+}
+
+// the setters keep vitals that are out of range, like loadSnapshot
+static Patient getPatient(const string& data, size_t& pos, size_t end) {
+    Patient patient;
+    patient.setTemperature((int)getInt(data, pos, end));
+    patient.setOxygen((int)getInt(data, pos, end));
+    patient.setRR((int)getInt(data, pos, end));
+    patient.setBP((int)getInt(data, pos, end));
+    patient.setOpinion((int)getInt(data, pos, end));
+    uint32_t length = getInt(data, pos, end);
+    if (end - pos < length) {
+        throw domain_error("The journal is damaged");
+    }
+    patient.setPatient(data.substr(pos, length));
+    pos += length;
+    return patient;
+}
+
+// write may take only part of the data, and is retried if a signal stops it
+static bool writeAll(int fd, const string& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = ::write(fd, data.data() + written, data.size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        written += count;
+    }
+    return true;
+}
+
+// makes renames in the directory of path survive a crash
+static void syncDirectory(const string& path) {
+    size_t slash = path.rfind('/');
+    string directory = (slash == string::npos) ? "." : path.substr(0, slash + 1);
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        ::close(fd);
+    }
+}
+
+static void syncFile(const string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fsync(fd) != 0) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        throw runtime_error("Can not write " + path);
+    }
+    ::close(fd);
+}
+
+// writes an empty journal for the snapshot with snapshotHash
+static void writeJournal(const string& path, uint64_t snapshotHash) {
+    string header("PQJL");
+    putInt(header, JOURNALVERSION);
+    putInt(header, JOURNALORDER);
+    header.append((const char*)&snapshotHash, sizeof(snapshotHash));
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool written = (fd >= 0) && writeAll(fd, header) && fsync(fd) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    if (!written) {
+        throw runtime_error("Can not write the journal " + path);
+    }
+}
+
+// Queues that PQueue::mergeWithQueue would merge
+static void checkMerge(const PQueue& queue, const PQueue& rhs) {
+    bool samePriority = (queue.hasPriorityPolicy() == rhs.hasPriorityPolicy()) &&
+        (queue.hasPriorityPolicy() ? queue.getPriorityPolicy() == rhs.getPriorityPolicy()
+                                   : queue.getPriorityFn() == rhs.getPriorityFn());
+    if (!samePriority || queue.getStructure() != rhs.getStructure()) {
+        throw domain_error("Queues have different structures or types");
+    }
+}
+
+JournaledPQueue::JournaledPQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure,
+                                 const string& snapshotPath, const string& journalPath,
+                                 int batchSize, int windowMicros)
+    : m_queue(priFn, heapType, structure), m_snapshotPath(snapshotPath),
+      m_journalPath(journalPath) {
+    open(batchSize, windowMicros);
+}
+
+JournaledPQueue::JournaledPQueue(const PriorityPolicy& policy, HEAPTYPE heapType,
+                                 STRUCTURE structure, const string& snapshotPath,
+                                 const string& journalPath, int batchSize, int windowMicros)
+    : m_queue(policy, heapType, structure), m_snapshotPath(snapshotPath),
+      m_journalPath(journalPath) {
+    open(batchSize, windowMicros);
+}
+
+// Loads the snapshot, replays the journal and opens it for appending.  A
+// journal written for another snapshot is left over from a compaction
+// that renamed the new snapshot and then crashed, its records are already
+// in the snapshot so it is replaced by an empty one.
+void JournaledPQueue::open(int batchSize, int windowMicros) {
+    if (batchSize < 1) {
+        throw out_of_range("A group needs at least 1 record");
+    }
+    if (windowMicros < 0) {
+        throw out_of_range("The window can not be negative");
+    }
+    m_fd = -1;
+    m_batchSize = batchSize;
+    m_window = windowMicros;
+    m_pending = 0;
+    m_lastRecord = 0;
+    m_durable = 0;
+    m_committing = false;
+    m_failed = false;
+    m_stopping = false;
+    m_syncs = 0;
+    m_records = 0;
+
+    string journal;
+    {
+        ifstream file(m_journalPath.c_str(), ios::binary);
+        journal.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    }
+    // a new queue starts with a snapshot of itself, so its heap type and
+    // structure are on disk before the first record
+    if (ifstream(m_snapshotPath.c_str(), ios::binary)) {
+        m_queue.loadSnapshot(m_snapshotPath);
+    }
+    else if (!journal.empty()) {
+        throw domain_error("The journal has no snapshot");
+    }
+    else {
+        string temp = m_snapshotPath + ".tmp";
+        m_queue.saveSnapshot(temp);
+        syncFile(temp);
+        if (rename(temp.c_str(), m_snapshotPath.c_str()) != 0) {
+            throw runtime_error("Can not write the snapshot " + m_snapshotPath);
+        }
+        syncDirectory(m_snapshotPath);
+    }
+    uint64_t snapshotHash = hashFile(m_snapshotPath);
+
+    size_t end = 0;
+    if (!journal.empty()) {
+        uint32_t version, order;
+        uint64_t hash;
+        if (journal.size() < JOURNALHEADER || journal.compare(0, 4, "PQJL") != 0) {
+            throw domain_error("Not a journal");
+        }
+        memcpy(&version, journal.data() + 4, sizeof(version));
+        memcpy(&order, journal.data() + 8, sizeof(order));
+        memcpy(&hash, journal.data() + 12, sizeof(hash));
+        if (version != JOURNALVERSION) {
+            throw domain_error("The journal has an unknown version");
+        }
+        if (order != JOURNALORDER) {
+            throw domain_error("The journal has the wrong byte order");
+        }
+        if (hash == snapshotHash) {
+            replay(journal, end);
+        }
+    }
+    if (end == 0) {
+        string temp = m_journalPath + ".tmp";
+        writeJournal(temp, snapshotHash);
+        if (rename(temp.c_str(), m_journalPath.c_str()) != 0) {
+            throw runtime_error("Can not write the journal " + m_journalPath);
+        }
+        syncDirectory(m_journalPath);
+    }
+
+    m_fd = ::open(m_journalPath.c_str(), O_WRONLY | O_APPEND);
+    if (m_fd < 0) {
+        throw runtime_error("Can not write the journal " + m_journalPath);
+    }
+    // cuts off a record that was only partly written when the process died
+    if (end != 0 && end < journal.size()) {
+        if (ftruncate(m_fd, end) != 0 || fsync(m_fd) != 0) {
+            ::close(m_fd);
+            throw runtime_error("Can not write the journal " + m_journalPath);
+        }
+    }
+    if (m_window > 0) {
+        m_flusher = thread(&JournaledPQueue::flushLoop, this);
+    }
+}
+
+// Applies the records of journal to m_queue up to the first one that is
+// cut short or fails its hash, and sets end to where that one starts.
+// Replaying makes the same calls as the first time, so the heap comes out
+// the same shape and every REMOVE takes out the same patient.
+void JournaledPQueue::replay(const string& journal, size_t& end) {
+    size_t pos = JOURNALHEADER;
+    end = pos;
+    while (journal.size() - pos >= RECORDOVERHEAD) {
+        uint32_t length;
+        memcpy(&length, journal.data() + pos + 1, sizeof(length));
+        if (journal.size() - pos - RECORDOVERHEAD < length) {
+            break;
+        }
+        uint32_t hash;
+        memcpy(&hash, journal.data() + pos + 5 + length, sizeof(hash));
+        if (hash != hash32(journal.data() + pos, 5 + length)) {
+            break;
+        }
+
+        int type = (unsigned char)journal[pos];
+        size_t next = pos + 5;
+        size_t payloadEnd = next + length;
+        if (type == INSERT) {
+            m_queue.insertPatient(getPatient(journal, next, payloadEnd));
+        }
+        else if (type == REMOVE) {
+            int key = (int)getInt(journal, next, payloadEnd);
+            if (m_queue.numPatients() == 0 || keyOf(m_queue.getNextPatient()) != key) {
+                throw domain_error("The journal does not match the snapshot");
+            }
+        }
+        else if (type == MERGE) {
+            uint32_t count = getInt(journal, next, payloadEnd);
+            vector<Patient> patients;
+            for (uint32_t i = 0; i < count; i++) {
+                patients.push_back(getPatient(journal, next, payloadEnd));
+            }
+            m_queue.insertPatients(patients.begin(), patients.end());
+        }
+        else if (type == CLEAR) {
+            m_queue.clear();
+        }
+        else {
+            throw domain_error("The journal is damaged");
+        }
+        if (next != payloadEnd) {
+            throw domain_error("The journal is damaged");
+        }
+        pos = payloadEnd + sizeof(hash);
+        end = pos;
+        m_records++;
+    }
+}
+
+JournaledPQueue::~JournaledPQueue() {
+    {
+        lock_guard<mutex> guard(m_lock);
+        m_stopping = true;
+        m_changed.notify_all();
+    }
+    if (m_flusher.joinable()) {
+        m_flusher.join();
+    }
+    unique_lock<mutex> guard(m_lock);
+    try {
+        if (!m_failed) {
+            commitAll(guard);
+        }
+    }
+    catch (runtime_error& e) {
+        // nothing more can be done about it in a destructor
+    }
+    ::close(m_fd);
+}
+
+int JournaledPQueue::keyOf(const Patient& patient) const {
+    if (m_queue.hasPriorityPolicy()) {
+        return m_queue.getPriorityPolicy().score(patient);
+    }
+    return m_queue.getPriorityFn()(patient);
+}
+
+// starts a record in m_buffer, endRecord fills in the length once the
+// payload is there
+size_t JournaledPQueue::beginRecord(RECORDTYPE type) {
+    size_t start = m_buffer.size();
+    m_buffer.push_back(char(type));
+    putInt(m_buffer, 0);
+    return start;
+}
+
+void JournaledPQueue::finishRecord(size_t start) {
+    uint32_t length = (uint32_t)(m_buffer.size() - start - 5);
+    memcpy(&m_buffer[start + 1], &length, sizeof(length));
+    putInt(m_buffer, hash32(m_buffer.data() + start, m_buffer.size() - start));
+    m_lastRecord++;
+    m_records++;
+    if (m_pending++ == 0) {
+        m_groupStart = chrono::steady_clock::now();
+        m_changed.notify_all();
+    }
+}
+
+// same as finishRecord, and commits the group once it is full
+void JournaledPQueue::endRecord(size_t start, unique_lock<mutex>& guard) {
+    finishRecord(start);
+    if (m_pending >= m_batchSize) {
+        commit(guard);
+    }
+}
+
+// Writes the records in m_buffer and fsyncs them as one group.  The lock
+// is let go while writing, so other threads can add the records of the
+// next group meanwhile.  Only one group is written at a time.
+void JournaledPQueue::commit(unique_lock<mutex>& guard) {
+    while (m_committing) {
+        m_changed.wait(guard);
+    }
+    if (m_pending == 0) {
+        return;
+    }
+    string group;
+    group.swap(m_buffer);
+    long long last = m_lastRecord;
+    m_pending = 0;
+    m_committing = true;
+    guard.unlock();
+    bool written = writeAll(m_fd, group) && fsync(m_fd) == 0;
+    guard.lock();
+    m_committing = false;
+    committed(group, last, written);
+}
+
+// Same as commit, without letting go of the lock.  The caller makes sure
+// no group is being written.
+void JournaledPQueue::commitLocked() {
+    if (m_pending == 0) {
+        return;
+    }
+    string group;
+    group.swap(m_buffer);
+    m_pending = 0;
+    bool written = writeAll(m_fd, group) && fsync(m_fd) == 0;
+    committed(group, m_lastRecord, written);
+}
+
+// the bookkeeping after group was written up to record last
+void JournaledPQueue::committed(string& group, long long last, bool written) {
+    if (written) {
+        m_durable = last;
+        m_syncs++;
+    }
+    else {
+        m_failed = true;
+    }
+    // gives the memory back to m_buffer for the next group
+    if (m_buffer.empty()) {
+        group.clear();
+        m_buffer.swap(group);
+    }
+    m_changed.notify_all();
+    checkFailed();
+}
+
+// commits until every record added so far is on disk
+void JournaledPQueue::commitAll(unique_lock<mutex>& guard) {
+    long long target = m_lastRecord;
+    while (m_durable < target || m_committing) {
+        checkFailed();
+        commit(guard);
+    }
+}
+
+// the flusher thread, it commits a group once its first record is m_window
+// microseconds old
+void JournaledPQueue::flushLoop() {
+    unique_lock<mutex> guard(m_lock);
+    while (!m_stopping) {
+        if (m_pending == 0 || m_committing || m_failed) {
+            m_changed.wait(guard);
+            continue;
+        }
+        chrono::steady_clock::time_point deadline = m_groupStart + chrono::microseconds(m_window);
+        if (chrono::steady_clock::now() < deadline) {
+            m_changed.wait_until(guard, deadline);
+            continue;
+        }
+        try {
+            commit(guard);
+        }
+        catch (runtime_error& e) {
+            // m_failed is set, so the next call on the queue throws
+        }
+    }
+}
+
+void JournaledPQueue::checkFailed() const {
+    if (m_failed) {
+        throw runtime_error("Can not write the journal " + m_journalPath);
+    }
+}
+
+void JournaledPQueue::insertPatient(const Patient& input) {
+    unique_lock<mutex> guard(m_lock);
+    checkFailed();
+    m_queue.insertPatient(input);
+    size_t start = beginRecord(INSERT);
+    putPatient(m_buffer, input);
+    endRecord(start, guard);
+}
+
+Patient JournaledPQueue::getNextPatient() {
+    unique_lock<mutex> guard(m_lock);
+    checkFailed();
+    if (m_queue.numPatients() == 0) {
+        throw out_of_range("The heap is empty");
+    }
+    Patient patient = m_queue.getNextPatient();
+    size_t start = beginRecord(REMOVE);
+    putInt(m_buffer, keyOf(patient));
+    endRecord(start, guard);
+    return patient;
+}
+
+// The patients go in with insertPatients in the order the journal has
+// them, so the replay builds the same heap
+void JournaledPQueue::mergeWithQueue(PQueue& rhs) {
+    unique_lock<mutex> guard(m_lock);
+    checkFailed();
+    checkMerge(m_queue, rhs);
+    vector<Patient> patients(rhs.begin(), rhs.end());
+    m_queue.insertPatients(patients.begin(), patients.end());
+    rhs.clear();
+    size_t start = beginRecord(MERGE);
+    putInt(m_buffer, (uint32_t)patients.size());
+    for (int i = 0; i < (int)patients.size(); i++) {
+        putPatient(m_buffer, patients[i]);
+    }
+    endRecord(start, guard);
+}
+
+void JournaledPQueue::mergeWithQueue(JournaledPQueue& rhs) {
+    // protects from self-merging
+    if (this == &rhs) {
+        return;
+    }
+
+    // waits until neither queue is writing a group, so both can commit
+    // while holding both locks
+    unique_lock<mutex> guard(m_lock, defer_lock);
+    unique_lock<mutex> rhsGuard(rhs.m_lock, defer_lock);
+    while (true) {
+        lock(guard, rhsGuard);
+        if (!m_committing && !rhs.m_committing) {
+            break;
+        }
+        rhsGuard.unlock();
+        if (m_committing) {
+            m_changed.wait(guard);
+            guard.unlock();
+            continue;
+        }
+        guard.unlock();
+        rhsGuard.lock();
+        while (rhs.m_committing) {
+            rhs.m_changed.wait(rhsGuard);
+        }
+        rhsGuard.unlock();
+    }
+    checkFailed();
+    rhs.checkFailed();
+    checkMerge(m_queue, rhs.m_queue);
+    vector<Patient> patients(rhs.m_queue.begin(), rhs.m_queue.end());
+    m_queue.insertPatients(patients.begin(), patients.end());
+    rhs.m_queue.clear();
+    size_t start = beginRecord(MERGE);
+    putInt(m_buffer, (uint32_t)patients.size());
+    for (int i = 0; i < (int)patients.size(); i++) {
+        putPatient(m_buffer, patients[i]);
+    }
+    finishRecord(start);
+    commitLocked();
+    rhs.finishRecord(rhs.beginRecord(CLEAR));
+    rhs.commitLocked();
+}
+
+void JournaledPQueue::clear() {
+    unique_lock<mutex> guard(m_lock);
+    checkFailed();
+    m_queue.clear();
+    endRecord(beginRecord(CLEAR), guard);
+}
+
+int JournaledPQueue::numPatients() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_queue.numPatients();
+}
+
+const PQueue& JournaledPQueue::getQueue() const {
+    return m_queue;
+}
+
+void JournaledPQueue::sync() {
+    unique_lock<mutex> guard(m_lock);
+    checkFailed();
+    commitAll(guard);
+}
+
+// The new snapshot and journal are written next to the old ones and then
+// renamed over them.  A crash between the two renames leaves the new
+// snapshot with the old journal, whose snapshot hash no longer matches, so
+// its records are not applied twice.
+void JournaledPQueue::compact() {
+    unique_lock<mutex> guard(m_lock);
+    checkFailed();
+    commitAll(guard);
+    string snapshotTemp = m_snapshotPath + ".tmp";
+    string journalTemp = m_journalPath + ".tmp";
+    m_queue.saveSnapshot(snapshotTemp);
+    syncFile(snapshotTemp);
+    writeJournal(journalTemp, hashFile(snapshotTemp));
+    if (rename(snapshotTemp.c_str(), m_snapshotPath.c_str()) != 0) {
+        throw runtime_error("Can not write the snapshot " + m_snapshotPath);
+    }
+    syncDirectory(m_snapshotPath);
+    // the old journal is tied to the old snapshot, so from here on a
+    // failure can not leave the queue writing to it
+    if (rename(journalTemp.c_str(), m_journalPath.c_str()) != 0) {
+        m_failed = true;
+        throw runtime_error("Can not write the journal " + m_journalPath);
+    }
+    syncDirectory(m_journalPath);
+
+    int fd = ::open(m_journalPath.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        m_failed = true;
+        throw runtime_error("Can not write the journal " + m_journalPath);
+    }
+    ::close(m_fd);
+    m_fd = fd;
+    m_records = 0;
+}
+
+int JournaledPQueue::numSyncs() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_syncs;
+}
+
+int JournaledPQueue::numRecords() const {
+    lock_guard<mutex> guard(m_lock);
+    return m_records;
+}
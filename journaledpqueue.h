@@ -0,0 +1,101 @@
+// CMSC 341 - Fall 2023 - Project 3
+#ifndef JOURNALEDPQUEUE_H
+#define JOURNALEDPQUEUE_H
+
+#include "pqueue.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+using namespace std;
+
+class JournaledPQueue {
+    // A PQueue that keeps an append-only journal of its changes, so no
+    // patient is lost if the process dies.  The queue lives in two files, a
+    // snapshot written by PQueue::saveSnapshot and a journal of the
+    // insertPatient, getNextPatient, mergeWithQueue and clear calls made
+    // since.  Opening a JournaledPQueue loads the snapshot and replays the
+    // journal on top of it, dropping a last record that was only half
+    // written.  compact folds the journal into a fresh snapshot.
+    //
+    // Records are buffered and written with one fsync per group (group
+    // commit).  A group is committed once it has batchSize records, once
+    // its first record is windowMicros old, or by sync.  A crash loses at
+    // most the records that were not committed yet, and batchSize 1
+    // commits every record before the call returns.  Several threads can
+    // share the queue, and their records share the fsyncs.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    // Opens the queue saved in snapshotPath and journalPath, or starts an
+    // empty one if they do not exist.  A saved queue keeps the heap type,
+    // structure and policy it was saved with.  A windowMicros of 0 only
+    // commits full groups and on sync.  Throws runtime_error if the files can not
+    // be read or written and domain_error if they do not hold a queue.
+    JournaledPQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure,
+                    const string& snapshotPath, const string& journalPath,
+                    int batchSize = 64, int windowMicros = 1000);
+    JournaledPQueue(const PriorityPolicy& policy, HEAPTYPE heapType, STRUCTURE structure,
+                    const string& snapshotPath, const string& journalPath,
+                    int batchSize = 64, int windowMicros = 1000);
+    ~JournaledPQueue(); // commits the records that are left
+    void insertPatient(const Patient& input);
+    // Throws out_of_range if the queue is empty
+    Patient getNextPatient();
+    // Moves the patients of rhs into this queue, rhs must have the same
+    // priority function and structure.  This queue commits before rhs, so
+    // a crash in between can queue the patients twice but never loses them.
+    void mergeWithQueue(JournaledPQueue& rhs);
+    void mergeWithQueue(PQueue& rhs);
+    void clear();
+    int numPatients() const;
+    const PQueue& getQueue() const; // not thread safe
+    // Waits until every call made so far is on disk
+    void sync();
+    // Writes the queue to a new snapshot and starts an empty journal.  The
+    // files are replaced by renaming, so a crash keeps either the old pair
+    // or the new one.
+    void compact();
+    int numSyncs() const;   // fsyncs of the journal so far
+    int numRecords() const; // records in the journal since the last compaction
+
+private:
+    enum RECORDTYPE {INSERT = 1, REMOVE = 2, MERGE = 3, CLEAR = 4};
+
+    mutable mutex m_lock;      // guards every member below
+    condition_variable m_changed; // a group started or committed, or stopping
+    PQueue m_queue;
+    string m_snapshotPath;
+    string m_journalPath;
+    int m_fd;                  // the journal, open for appending
+    int m_batchSize;
+    int m_window;              // microseconds, 0 for no flusher thread
+    string m_buffer;           // records that are not written yet
+    int m_pending;             // records in m_buffer
+    chrono::steady_clock::time_point m_groupStart; // when m_buffer got its first record
+    long long m_lastRecord;    // number of the last record added
+    long long m_durable;       // number of the last record on disk
+    bool m_committing;         // a group is being written without the lock
+    bool m_failed;             // writing the journal failed
+    bool m_stopping;
+    int m_syncs;
+    int m_records;
+    thread m_flusher;          // commits groups whose window ran out
+
+    JournaledPQueue(const JournaledPQueue& rhs);            // not copyable
+    JournaledPQueue& operator=(const JournaledPQueue& rhs); // not copyable
+    void open(int batchSize, int windowMicros);
+    void replay(const string& journal, size_t& end);
+    int keyOf(const Patient& patient) const;
+    size_t beginRecord(RECORDTYPE type);
+    void finishRecord(size_t start);
+    void endRecord(size_t start, unique_lock<mutex>& guard);
+    void commit(unique_lock<mutex>& guard);
+    void commitLocked();
+    void committed(string& group, long long last, bool written);
+    void commitAll(unique_lock<mutex>& guard);
+    void flushLoop();
+    void checkFailed() const;
+};
+
+#endif
@@ -1,8 +1,19 @@
 #include "pqueue.h"
+#include "concurrentpqueue.h"
+#include "basicpqueue.h"
+#include "journaledpqueue.h"
+#include "patientloader.h"
 #include <math.h>
 #include <algorithm>
 #include <random>
 #include <vector>
+#include <thread>
+#include <iterator>
+#include <fstream>
+#include <cstdio>
+#include <chrono>
+#include <sstream>
+#include <sys/stat.h>
 using namespace std;
 
 // Priority functions compute an integer priority for a patient.  Internal
@@ -10,6 +21,14 @@ using namespace std;
 
 int priorityFn1(const Patient & patient);
 int priorityFn2(const Patient & patient);
+int countingPriorityFn(const Patient & patient);
+int bloodPressureFn(const Patient & patient);
+int throwingPriorityFn(const Patient & patient);
+int throwOnceFn(const Patient & patient);
+PriorityPolicy policyFn1(); // priorityFn1 as a PriorityPolicy
+PriorityPolicy policyFn2(); // priorityFn2 as a PriorityPolicy
+int priorityCalls = 0; // number of calls to countingPriorityFn
+bool throwOnce = false; // throwOnceFn throws for the next "Unscorable"
 
 // a name database for testing purposes
 const int NUMNAMES = 20;
@@ -147,9 +166,101 @@ int priorityFn2(const Patient & patient) {
     return priority;
 }
 
+int countingPriorityFn(const Patient & patient) {
+    // same as priorityFn2, but counts how many times it is called
+    priorityCalls++;
+    return priorityFn2(patient);
+}
+
+int bloodPressureFn(const Patient & patient) {
+    // the blood pressure alone, setBP does not check the range so this
+    // can give every patient a different priority
+    return patient.getBP();
+}
+
+int throwingPriorityFn(const Patient & patient) {
+    // priorityFn2, except it can not score a patient named "Unscorable"
+    if (patient.getPatient() == "Unscorable") {
+        throw domain_error("Can not score the patient");
+    }
+    return priorityFn2(patient);
+}
+
+int throwOnceFn(const Patient & patient) {
+    // same as throwingPriorityFn, but only once after throwOnce is set
+    if (throwOnce && patient.getPatient() == "Unscorable") {
+        throwOnce = false;
+        throw domain_error("Can not score the patient");
+    }
+    return priorityFn2(patient);
+}
+
+PriorityPolicy policyFn1() {
+    // temperature + respiratory + blood pressure, for a MAXHEAP
+    PriorityPolicy policy;
+    policy.setWeight(TEMPERATURE, 1);
+    policy.setWeight(RESPIRATORY, 1);
+    policy.setWeight(BLOODPRESSURE, 1);
+    return policy;
+}
+
+PriorityPolicy policyFn2() {
+    // nurse opinion + oxygen, for a MINHEAP
+    PriorityPolicy policy;
+    policy.setWeight(OXYGEN, 1);
+    policy.setWeight(OPINION, 1);
+    return policy;
+}
+
 class Tester {
     public:
 
+    // returns true if every cached key matches the priority function
+    // returns true if both trees have the same shape, patients, keys, NPLs
+    // and cancelled nodes
+    bool sameTree(const Node* ptr1, const Node* ptr2) {
+        if (ptr1 == nullptr || ptr2 == nullptr) {
+            return ptr1 == ptr2;
+        }
+        return (ptr1->m_patient == ptr2->m_patient) && (ptr1->m_key == ptr2->m_key) &&
+               (ptr1->m_npl == ptr2->m_npl) && (ptr1->m_dead == ptr2->m_dead) &&
+               sameTree(ptr1->m_left, ptr2->m_left) && sameTree(ptr1->m_right, ptr2->m_right);
+    }
+
+    bool keysMatch(Node* ptr, prifn_t priFn) {
+        if (ptr == nullptr) {
+            return true;
+        }
+        if (ptr->m_key != priFn(ptr->m_patient)) {
+            return false;
+        }
+        return keysMatch(ptr->m_left, priFn) && keysMatch(ptr->m_right, priFn);
+    }
+
+    // checks every child points back at its parent and the root has none
+    bool parentsMatch(Node* root) {
+        if (root == nullptr) {
+            return true;
+        }
+        if (root->m_parent != nullptr) {
+            return false;
+        }
+        vector<Node*> stack(1, root);
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            if (node->m_left) {
+                if (node->m_left->m_parent != node) return false;
+                stack.push_back(node->m_left);
+            }
+            if (node->m_right) {
+                if (node->m_right->m_parent != node) return false;
+                stack.push_back(node->m_right);
+            }
+        }
+        return true;
+    }
+
     // tests constructor
     bool constructorNormal() {
         bool result = true;
@@ -548,6 +659,35 @@ class Tester {
         return aQueue.testNPL(aQueue.m_heap);
     }
 
+    // tests npl values stay correct after removals, which only fix the merge path
+    bool testNPLValueAfterRemoval() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            aQueue.insertPatient(patient);
+        }
+
+        bool result = true;
+        for (int i = 0; i < 150; i++) {
+            aQueue.getNextPatient();
+            result = result && aQueue.testNPL(aQueue.m_heap);
+            result = result && aQueue.leftistProperty(aQueue.m_heap);
+        }
+
+        return result;
+    }
+
     bool setPriority() {
         Random nameGen(0,NUMNAMES-1);
         Random temperatureGen(MINTEMP,MAXTEMP);
@@ -578,16 +718,17 @@ class Tester {
         return result;
     }
 
-    // tests merge for normal case
-    bool mergeNormal() {
+    // tests keys are cached on insert, kept by setStructure and recomputed by setPriorityFn
+    bool cachedKeys() {
         Random nameGen(0,NUMNAMES-1);
         Random temperatureGen(MINTEMP,MAXTEMP);
         Random oxygenGen(MINOX,MAXOX);
         Random respiratoryGen(MINRR,MAXRR);
         Random bloodPressureGen(MINBP,MAXBP);
         Random nurseOpinionGen(MINOPINION,MAXOPINION);
-        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
-        for (int i=0;i<1;i++){
+        PQueue aQueue(countingPriorityFn, MINHEAP, LEFTIST);
+        priorityCalls = 0;
+        for (int i=0;i<50;i++){
             Patient patient(nameDB[nameGen.getRandNum()],
                         temperatureGen.getRandNum(),
                         oxygenGen.getRandNum(),
@@ -597,30 +738,24 @@ class Tester {
             aQueue.insertPatient(patient);
         }
 
-        Random nameGen2(0,NUMNAMES-1);
-        Random temperatureGen2(MINTEMP,MAXTEMP);
-        Random oxygenGen2(MINOX,MAXOX);
-        Random respiratoryGen2(MINRR,MAXRR);
-        Random bloodPressureGen2(MINBP,MAXBP);
-        Random nurseOpinionGen2(MINOPINION,MAXOPINION);
-        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
-        for (int i=0;i<1;i++){
-            Patient patient(nameDB[nameGen.getRandNum()],
-                        temperatureGen.getRandNum(),
-                        oxygenGen.getRandNum(),
-                        respiratoryGen.getRandNum(),
-                        bloodPressureGen.getRandNum(),
-                        nurseOpinionGen.getRandNum());
-            bQueue.insertPatient(patient);
-        }
+        bool result = true;
+        // one call per insert, none for the comparisons
+        result = result && (priorityCalls == 50);
+        result = result && keysMatch(aQueue.m_heap, priorityFn2);
 
-        aQueue.mergeWithQueue(bQueue);
+        aQueue.setStructure(SKEW);
+        result = result && (priorityCalls == 50);
+        result = result && keysMatch(aQueue.m_heap, priorityFn2);
 
-        return (aQueue.m_heap->m_left || aQueue.m_heap->m_right);
+        aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+        result = result && keysMatch(aQueue.m_heap, priorityFn1);
+        result = result && aQueue.heapPropertyMaxTest();
+
+        return result;
     }
 
-    // tests merge with empty queue
-    bool mergeEdge() {
+    // tests updating a patient refreshes its key and its place in the heap
+    bool updatePatientTest() {
         Random nameGen(0,NUMNAMES-1);
         Random temperatureGen(MINTEMP,MAXTEMP);
         Random oxygenGen(MINOX,MAXOX);
@@ -628,7 +763,8 @@ class Tester {
         Random bloodPressureGen(MINBP,MAXBP);
         Random nurseOpinionGen(MINOPINION,MAXOPINION);
         PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
-        for (int i=0;i<1;i++){
+        vector<Patient> patients;
+        for (int i=0;i<100;i++){
             Patient patient(nameDB[nameGen.getRandNum()],
                         temperatureGen.getRandNum(),
                         oxygenGen.getRandNum(),
@@ -636,16 +772,32 @@ class Tester {
                         bloodPressureGen.getRandNum(),
                         nurseOpinionGen.getRandNum());
             aQueue.insertPatient(patient);
+            patients.push_back(patient);
         }
-        
-        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
-        aQueue.mergeWithQueue(bQueue);
 
-        return (!aQueue.m_heap->m_left && !aQueue.m_heap->m_right);
+        // lowest valid priority value for priorityFn2 is 71, so the updated
+        // patient is given a lower one to make it the only possible root
+        Patient urgent("Urgent Patient", 40, 70, 30, 120, 1);
+        urgent.setOxygen(60);
+        bool result = true;
+        result = result && aQueue.updatePatient(patients[60], urgent);
+        result = result && (aQueue.m_heap->m_patient == urgent);
+        result = result && (aQueue.m_heap->m_key == priorityFn2(urgent));
+        result = result && aQueue.heapPropertyMinTest();
+        result = result && aQueue.testNPL(aQueue.m_heap);
+        result = result && aQueue.leftistProperty(aQueue.m_heap);
+        result = result && (aQueue.numPatients() == 100);
+
+        // a patient that is not queued is not updated
+        Patient missing("Missing Patient", 37, 100, 20, 100, 10);
+        result = result && !aQueue.updatePatient(missing, urgent);
+
+        return result;
     }
 
-    // tests case to merge with different structure/priority function
-    bool mergeError() {
+    // tests nodes are recycled by the pool, so a queue that is drained and
+    // filled again does not allocate new slabs
+    bool poolReuse() {
         Random nameGen(0,NUMNAMES-1);
         Random temperatureGen(MINTEMP,MAXTEMP);
         Random oxygenGen(MINOX,MAXOX);
@@ -653,143 +805,2422 @@ class Tester {
         Random bloodPressureGen(MINBP,MAXBP);
         Random nurseOpinionGen(MINOPINION,MAXOPINION);
         PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
-        PQueue bQueue(priorityFn1, MINHEAP, SKEW);
-        for (int i=0;i<1;i++){
+        vector<Patient> patients;
+        for (int i=0;i<1000;i++){
             Patient patient(nameDB[nameGen.getRandNum()],
                         temperatureGen.getRandNum(),
                         oxygenGen.getRandNum(),
                         respiratoryGen.getRandNum(),
                         bloodPressureGen.getRandNum(),
                         nurseOpinionGen.getRandNum());
-            aQueue.insertPatient(patient);
-            bQueue.insertPatient(patient);
+            patients.push_back(patient);
         }
 
-        try {
-            aQueue.mergeWithQueue(bQueue);
-            return false;
+        for (int i=0;i<1000;i++){
+            aQueue.insertPatient(patients[i]);
         }
-        catch(domain_error& e) {
-            return true;
+        for (int i=0;i<1000;i++){
+            aQueue.getNextPatient();
         }
+        int slabs = aQueue.m_pool.slabAllocations();
 
-        return true;
-    }
+        bool result = true;
+        result = result && (aQueue.m_pool.liveNodes() == 0);
+        for (int round=0;round<3;round++){
+            for (int i=0;i<1000;i++){
+                aQueue.insertPatient(patients[i]);
+            }
+            for (int i=0;i<500;i++){
+                aQueue.getNextPatient();
+            }
+            result = result && (aQueue.m_pool.liveNodes() == aQueue.numPatients());
+            for (int i=0;i<500;i++){
+                aQueue.getNextPatient();
+            }
+        }
+        result = result && (aQueue.m_pool.slabAllocations() == slabs);
+        result = result && (aQueue.m_pool.nodeAllocations() == 4000);
 
-};
+        // merging hands the slabs of rhs over with its nodes
+        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
+        for (int i=0;i<100;i++){
+            aQueue.insertPatient(patients[i]);
+            bQueue.insertPatient(patients[i]);
+        }
+        aQueue.mergeWithQueue(bQueue);
+        result = result && (aQueue.m_pool.liveNodes() == 200);
+        result = result && (bQueue.m_pool.liveNodes() == 0);
+        result = result && bQueue.m_pool.m_slabs.empty();
 
+        // clear gives every slab back
+        aQueue.clear();
+        result = result && (aQueue.m_pool.liveNodes() == 0);
+        result = result && aQueue.m_pool.m_slabs.empty();
 
-int main() {
-    Tester test;
+        return result;
+    }
 
-    cout << endl;
+    // tests names are moved, not copied, on the insert and extract path.
+    // The names are too long for the small string buffer, so a moved string
+    // keeps the same character buffer.
+    bool moveSemantics() {
+        PQueue aQueue(priorityFn2, MINHEAP, SKEW);
+        bool result = true;
 
-    // test constructors
-    if (test.constructorNormal()) {
-        cout << "Normal Constructor passed" << endl;
-    }
-    else {
-        cout << "Normal Constructor failed" << endl;
-    }
+        Patient patient("Alexandra Montgomery-Fairweather", 39, 80, 25, 120, 2);
+        const char* name = patient.m_patient.data();
+        aQueue.insertPatient(std::move(patient));
+        result = result && (aQueue.m_heap->m_patient.m_patient.data() == name);
+
+        aQueue.emplacePatient("Bartholomew Featherstonehaugh", 38, 71, 22, 110, 1);
+        result = result && (aQueue.numPatients() == 2);
+        result = result && (aQueue.m_heap->m_key == priorityFn2(aQueue.m_heap->m_patient));
+
+        // the root moves its name out to the caller
+        const char* rootName = aQueue.m_heap->m_patient.m_patient.data();
+        Patient next = aQueue.getNextPatient();
+        result = result && (next.m_patient.data() == rootName);
+        result = result && (next.getPatient() == "Bartholomew Featherstonehaugh");
+
+        // moving a queue takes its nodes, the moved-from queue is empty
+        Node* heap = aQueue.m_heap;
+        PQueue bQueue(std::move(aQueue));
+        result = result && (bQueue.m_heap == heap) && (bQueue.numPatients() == 1);
+        result = result && (aQueue.m_heap == nullptr) && (aQueue.numPatients() == 0);
+        result = result && (aQueue.m_pool.liveNodes() == 0) && (bQueue.m_pool.liveNodes() == 1);
+        result = result && aQueue.m_pool.m_slabs.empty();
+
+        PQueue cQueue(priorityFn1, MAXHEAP, LEFTIST);
+        cQueue.insertPatient(next);
+        cQueue = std::move(bQueue);
+        result = result && (cQueue.m_heap == heap) && (cQueue.numPatients() == 1);
+        result = result && (cQueue.m_priorFunc == priorityFn2) && (cQueue.m_structure == SKEW);
+        result = result && (bQueue.m_heap == nullptr) && (bQueue.numPatients() == 0);
+        result = result && (cQueue.m_heap->m_patient.m_patient.data() == name);
+        // the slabs were swapped, so the moved-from queue still works
+        result = result && bQueue.m_pool.m_slabs.empty();
+        bQueue.insertPatient(next);
+        result = result && (bQueue.numPatients() == 1) && (bQueue.getNextPatient() == next);
+
+        // rebuilding moves patients into the new heap too
+        cQueue.setStructure(LEFTIST);
+        result = result && (cQueue.m_heap->m_patient.m_patient.data() == name);
+
+        // a node that can not be built or scored goes back to the pool
+        PackedPQueue packed(priorityFn2, MINHEAP, SKEW);
+        Patient unpackable = next;
+        unpackable.setBP(1000);
+        for (int i = 0; i < 3; i++) {
+            try {
+                packed.insertPatient(unpackable);
+                result = false;
+            }
+            catch(out_of_range& e) {
+            }
+        }
+        result = result && (packed.numPatients() == 0) && (packed.m_pool.liveNodes() == 0);
+        PQueue dQueue(throwingPriorityFn, MINHEAP, LEFTIST);
+        dQueue.emplacePatient("Bartholomew Featherstonehaugh", 38, 71, 22, 110, 1);
+        try {
+            dQueue.emplacePatient("Unscorable", 38, 71, 22, 110, 1);
+            result = false;
+        }
+        catch(domain_error& e) {
+        }
+        result = result && (dQueue.numPatients() == 1) && (dQueue.m_pool.liveNodes() == 1);
 
-    if (test.copyConstructorNormal()) {
-        cout << "Copy constructor normal case passed" << endl;
-    }
-    else {
-        cout << "Copy constructor normal case failed" << endl;
+        return result;
     }
 
-    if (test.copyConstructorEdge()) {
-        cout << "Copy constructor edge case passed" << endl;
-    }
-    else {
-        cout << "Copy constructor edge case failed" << endl;
-    }
-    cout << endl;
+    // builds a million node skew heap from sorted input, which makes a
+    // degenerate tree, and checks nothing runs out of stack
+    bool stressSortedSkew(bool ascending) {
+        const int SIZE = 1000000;
+        PQueue aQueue(bloodPressureFn, MINHEAP, SKEW);
+        Patient patient("Stress Patient", 37, 100, 20, 100, 10);
+        for (int i=0;i<SIZE;i++){
+            patient.setBP(ascending ? i : SIZE - i);
+            aQueue.insertPatient(patient);
+        }
 
-    // tests assignment operator cases
-    if (test.assignmentOperatorNormal()) {
-        cout << "Overloaded assignment operator normal case passed" << endl;
-    }
-    else {
-        cout << "Overloaded assignment operator normal case failed" << endl;
-    }
+        bool result = true;
+        result = result && (aQueue.numPatients() == SIZE);
 
-    if (test.assignmentOperatorEdge()) {
-        cout << "Overloaded assignment operator edge case passed" << endl;
-    }
-    else {
-        cout << "Overloaded assignment operator edge case failed" << endl;
-    }
-    cout << endl;
+        // copy constructor, assignment and rebuilding all walk the whole tree
+        PQueue bQueue(aQueue);
+        result = result && (bQueue.numPatients() == SIZE);
+        bQueue.setStructure(LEFTIST);
+        result = result && (bQueue.numPatients() == SIZE);
+        bQueue = aQueue;
+        result = result && (bQueue.numPatients() == SIZE);
 
-    // tests insert function
-    if (test.insertTest()) {
-        cout << "Insert function test passed" << endl;
-    }
-    else {
-        cout << "Insert function test failed" << endl;
-    }
-    cout << endl;
+        // merging two degenerate heaps walks both long spines
+        aQueue.mergeWithQueue(bQueue);
+        result = result && (aQueue.numPatients() == 2 * SIZE);
+
+        // patients come out in priority order
+        int last = -1;
+        for (int i = 0; i < 1000; i++) {
+            int next = aQueue.getNextPatient().getBP();
+            result = result && (next >= last);
+            last = next;
+        }
 
-    // tests getNextPatient function
-    if (test.removeTestNormal()) {
-        cout << "Get next patient normal test passed" << endl;
-    }
-    else {
-        cout << "Get next patient normal test failed" << endl;
-    }
+        // updating a patient searches the whole degenerate tree
+        Patient missing("Missing Patient", 37, 100, 20, 100, 10);
+        result = result && !aQueue.updatePatient(missing, patient);
 
-    if (test.removeTestError()) {
-        cout << "Get next patient error case passed" << endl;
-    }
-    else {
-        cout << "Get next patient error case failed" << endl;
+        return result;
     }
-    cout << endl;
 
-    // tests insertion properties
-    if (test.insertionMinHeap()) {
-        cout << "Min heap insertion property test passed" << endl;
-    }
-    else {
-        cout << "Min heap insertion property test failed" << endl;
-    }
+    // tests the range constructor builds a valid heap of every structure
+    bool bulkConstructor() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<301;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
 
-    if (test.insertionMaxHeap()) {
-        cout << "Max heap insertion property test passed" << endl;
-    }
-    else {
-        cout << "Max heap insertion property test failed" << endl;
-    }
-    cout << endl;
+        bool result = true;
+        PQueue aQueue(patients.begin(), patients.end(), priorityFn2, MINHEAP, LEFTIST);
+        result = result && (aQueue.numPatients() == 301) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMinTest();
+        result = result && aQueue.testNPL(aQueue.m_heap);
+        result = result && aQueue.leftistProperty(aQueue.m_heap);
+        result = result && keysMatch(aQueue.m_heap, priorityFn2);
+
+        PQueue bQueue(patients.begin(), patients.end(), priorityFn1, MAXHEAP, SKEW);
+        result = result && (bQueue.numPatients() == 301) && bQueue.sizeMatchesTree();
+        result = result && bQueue.heapPropertyMaxTest();
+
+        // patients come out in priority order
+        int last = bQueue.m_heap->m_key;
+        while (bQueue.numPatients() > 0) {
+            int next = priorityFn1(bQueue.getNextPatient());
+            result = result && (next <= last);
+            last = next;
+        }
 
-    // tests removal properties
-    if (test.removalMinHeap()) {
-        cout << "Min heap removal property test passed" << endl;
-    }
-    else {
-        cout << "Min heap removal property test failed" << endl;
-    }
+        PQueue cQueue(patients.end(), patients.end(), priorityFn2, MINHEAP, SKEW);
+        result = result && (cQueue.m_heap == nullptr) && (cQueue.numPatients() == 0);
 
-    if (test.removalMaxHeap()) {
-        cout << "Max heap removal property test passed" << endl;
-    }
-    else {
-        cout << "Max heap removal property test failed" << endl;
+        return result;
     }
-    cout << endl;
 
-    // tests npl properties
-    if (test.leftistPropertyMinHeap()) {
-        cout << "Min heap leftist property passed" << endl;
-    }
-    else {
-        cout << "Min heap leftist property failed" << endl;
-    }
+    // tests inserting batches into queues that already have patients
+    bool batchInsert() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<400;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
 
-    if (test.leftistPropertyMaxHeap()) {
-        cout << "Max heap NPL property passed" << endl;
+        bool result = true;
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn1, MAXHEAP, structures[s]);
+            for (int i = 0; i < 100; i++) {
+                aQueue.insertPatient(patients[i]);
+            }
+            // a big batch, a small one and an empty one
+            aQueue.insertPatients(patients.begin() + 100, patients.begin() + 390);
+            aQueue.insertPatients(&patients[390], 10);
+            aQueue.insertPatients(&patients[0], 0);
+            result = result && (aQueue.numPatients() == 400);
+            if (structures[s] == DARY) {
+                result = result && aQueue.heapPropertyArray();
+            }
+            else {
+                result = result && aQueue.sizeMatchesTree() && aQueue.heapPropertyMaxTest();
+                result = result && keysMatch(aQueue.m_heap, priorityFn1);
+            }
+            if (structures[s] == LEFTIST) {
+                result = result && aQueue.testNPL(aQueue.m_heap);
+                result = result && aQueue.leftistProperty(aQueue.m_heap);
+            }
+
+            int last = priorityFn1(aQueue.getNextPatient());
+            while (aQueue.numPatients() > 0) {
+                int next = priorityFn1(aQueue.getNextPatient());
+                result = result && (next <= last);
+                last = next;
+            }
+        }
+
+        // move iterators move the names into the queue
+        vector<Patient> moved(patients.begin(), patients.begin() + 50);
+        PQueue bQueue(priorityFn2, MINHEAP, SKEW);
+        bQueue.insertPatients(make_move_iterator(moved.begin()),
+                              make_move_iterator(moved.end()));
+        result = result && (bQueue.numPatients() == 50) && bQueue.heapPropertyMinTest();
+        result = result && moved[0].getPatient().empty();
+
+        // a priority function that throws part way through a batch leaves
+        // the queue and its pool as they were, also after a rebuild
+        for (int s = 0; s < 4; s++) {
+            PQueue cQueue(throwingPriorityFn, MINHEAP, structures[s]);
+            cQueue.insertPatients(patients.begin(), patients.begin() + 100);
+            vector<Patient> batch(patients.begin() + 100, patients.begin() + 120);
+            batch[10] = Patient("Unscorable", 38, 71, 22, 110, 1);
+            try {
+                cQueue.insertPatients(batch.begin(), batch.end());
+                result = false;
+            }
+            catch(domain_error& e) {
+            }
+            result = result && (cQueue.numPatients() == 100) && cQueue.sizeMatchesTree();
+            result = result && (cQueue.m_pool.liveNodes() == (structures[s] == DARY ? 0 : 100));
+            cQueue.setPriorityFn(priorityFn2, MAXHEAP);
+            result = result && (cQueue.numPatients() == 100) && cQueue.sizeMatchesTree();
+            result = result && (structures[s] == DARY ? cQueue.heapPropertyArray() :
+                                structures[s] == PAIRING ? cQueue.heapPropertyPairing() :
+                                cQueue.heapPropertyMaxTest());
+        }
+
+        return result;
+    }
+
+    // tests removing and peeking at the top k patients of every structure
+    bool topK() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+
+        bool result = true;
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            PQueue bQueue(priorityFn2, MINHEAP, structures[s]);
+            for (int i = 0; i < 300; i++) {
+                aQueue.insertPatient(patients[i]);
+                bQueue.insertPatient(patients[i]);
+            }
+
+            // peeking gives the keys the removals give, and changes nothing
+            vector<Patient> peeked;
+            result = result && (aQueue.peekTopK(40, back_inserter(peeked)) == 40);
+            result = result && (aQueue.numPatients() == 300);
+            vector<Patient> removed;
+            result = result && (aQueue.getNextPatients(40, back_inserter(removed)) == 40);
+            result = result && (aQueue.numPatients() == 260);
+            for (int i = 0; i < 40; i++) {
+                int key = priorityFn2(bQueue.getNextPatient());
+                result = result && (priorityFn2(peeked[i]) == key);
+                result = result && (priorityFn2(removed[i]) == key);
+            }
+
+            if (structures[s] == DARY) {
+                result = result && aQueue.heapPropertyArray();
+            }
+            else {
+                result = result && aQueue.sizeMatchesTree() && aQueue.heapPropertyMinTest();
+                result = result && (aQueue.m_pool.liveNodes() == 260);
+            }
+            if (structures[s] == LEFTIST) {
+                result = result && aQueue.testNPL(aQueue.m_heap);
+                result = result && aQueue.leftistProperty(aQueue.m_heap);
+            }
+
+            // asking for more than are queued takes all of them
+            Patient beds[300];
+            result = result && (aQueue.getNextPatients(1000, beds) == 260);
+            result = result && (aQueue.numPatients() == 0);
+            result = result && (aQueue.getNextPatients(5, beds) == 0);
+            result = result && (aQueue.peekTopK(5, beds) == 0);
+            for (int i = 1; i < 260; i++) {
+                result = result && (priorityFn2(beds[i - 1]) <= priorityFn2(beds[i]));
+            }
+        }
+
+        return result;
+    }
+
+    // tests peekNextPatient and walking the queue in priority order
+    bool peekAndIterate() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        bool result = true;
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn1, MAXHEAP, structures[s]);
+            try {
+                aQueue.peekNextPatient();
+                result = false;
+            }
+            catch(out_of_range& e) {
+            }
+            result = result && (aQueue.begin() == aQueue.end());
+
+            for (int i=0;i<200;i++){
+                Patient patient(nameDB[nameGen.getRandNum()],
+                            temperatureGen.getRandNum(),
+                            oxygenGen.getRandNum(),
+                            respiratoryGen.getRandNum(),
+                            bloodPressureGen.getRandNum(),
+                            nurseOpinionGen.getRandNum());
+                aQueue.insertPatient(patient);
+            }
+            // removes a few so the pairing heap has some pairs to walk
+            aQueue.getNextPatient();
+            aQueue.getNextPatient();
+
+            PQueue bQueue(aQueue);
+            result = result && (aQueue.peekNextPatient() == *aQueue.begin());
+            result = result && (aQueue.peekNextPatient() == bQueue.getNextPatient());
+            result = result && (aQueue.numPatients() == 198);
+
+            // every patient is visited once, in the order they come out
+            PQueue cQueue(aQueue);
+            int count = 0;
+            for (const Patient& patient : aQueue) {
+                result = result && (priorityFn1(patient) == priorityFn1(cQueue.getNextPatient()));
+                count++;
+            }
+            result = result && (count == 198) && (aQueue.numPatients() == 198);
+
+            PQueue::const_iterator it = aQueue.begin();
+            PQueue::const_iterator first = it++;
+            result = result && (first == aQueue.begin()) && (it != first);
+            result = result && (first->getPatient() == aQueue.peekNextPatient().getPatient());
+        }
+
+        return result;
+    }
+
+    // tests updating and removing patients through the handles returned by
+    // insertPatient, against a list of the patients that should be queued
+    bool handles() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<400;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            // unique names, so a patient can be told apart from its twins
+            patient.setPatient(patient.getPatient() + " " + to_string(i));
+            patients.push_back(patient);
+        }
+
+        bool result = true;
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            vector<PatientHandle> handles;
+            vector<int> keys; // key of each handle's patient, -1 once removed
+            for (int i = 0; i < 300; i++) {
+                handles.push_back(aQueue.insertPatient(patients[i]));
+                keys.push_back(priorityFn2(patients[i]));
+            }
+            // some removals first, so the pairing heap is not just a root
+            // with a list of children
+            for (int i = 0; i < 20; i++) {
+                for (int j = 0; j < 300; j++) {
+                    if (keys[j] != -1 && aQueue.getPatient(handles[j]) == aQueue.peekNextPatient()) {
+                        keys[j] = -1;
+                        break;
+                    }
+                }
+                aQueue.getNextPatient();
+            }
+
+            // every third patient gets new vitals, every fifth is removed
+            for (int i = 0; i < 300; i++) {
+                if (keys[i] == -1) continue;
+                if (i % 3 == 0) {
+                    aQueue.updatePatient(handles[i], patients[300 + i / 3]);
+                    keys[i] = priorityFn2(patients[300 + i / 3]);
+                    result = result && (aQueue.getPatient(handles[i]) == patients[300 + i / 3]);
+                }
+                else if (i % 5 == 0) {
+                    Patient removed = aQueue.removePatient(handles[i]);
+                    result = result && (removed == patients[i]);
+                    keys[i] = -1;
+                }
+                if (structures[s] == DARY) {
+                    result = result && aQueue.heapPropertyArray();
+                }
+                else if (i % 10 == 0) {
+                    result = result && aQueue.heapPropertyMinTest() && parentsMatch(aQueue.m_heap);
+                }
+            }
+            if (structures[s] == LEFTIST) {
+                result = result && aQueue.testNPL(aQueue.m_heap);
+                result = result && aQueue.leftistProperty(aQueue.m_heap);
+            }
+
+            // handles of pointer based heaps survive rebuilds
+            if (structures[s] != DARY) {
+                aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+                aQueue.setPriorityFn(priorityFn2, MINHEAP);
+                result = result && parentsMatch(aQueue.m_heap);
+                aQueue.updatePatient(handles[1], patients[399]);
+                keys[1] = priorityFn2(patients[399]);
+            }
+
+            vector<int> expected;
+            for (int i = 0; i < 300; i++) {
+                if (keys[i] != -1) expected.push_back(keys[i]);
+            }
+            sort(expected.begin(), expected.end());
+            result = result && (aQueue.numPatients() == (int)expected.size());
+            for (int i = 0; i < (int)expected.size(); i++) {
+                result = result && (priorityFn2(aQueue.getNextPatient()) == expected[i]);
+            }
+        }
+
+        // bad handles
+        PQueue bQueue(priorityFn2, MINHEAP, DARY);
+        PatientHandle handle = bQueue.insertPatient(patients[0]);
+        bQueue.removePatient(handle);
+        try {
+            bQueue.removePatient(handle);
+            result = false;
+        }
+        catch(domain_error& e) {
+        }
+        PQueue cQueue(priorityFn2, MINHEAP, SKEW);
+        try {
+            cQueue.updatePatient(PatientHandle(), patients[0]);
+            result = false;
+        }
+        catch(domain_error& e) {
+        }
+
+        return result;
+    }
+
+    // tests cancelling patients, they must never come out of the queue and
+    // must be reclaimed by compaction
+    bool cancelPatients() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<400;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patient.setPatient(patient.getPatient() + " " + to_string(i));
+            patients.push_back(patient);
+        }
+
+        bool result = true;
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn1, MAXHEAP, structures[s]);
+            aQueue.setCompactionThreshold(0.5);
+            vector<PatientHandle> handles;
+            for (int i = 0; i < 400; i++) {
+                handles.push_back(aQueue.insertPatient(patients[i]));
+            }
+            aQueue.getNextPatient();
+            aQueue.getNextPatient();
+            // the two removed patients are found again through their keys
+            vector<bool> queued(400, true);
+            int removedCount = 0;
+            for (int i = 0; i < 400 && removedCount < 2; i++) {
+                bool found = false;
+                for (const Patient& patient : aQueue) {
+                    if (patient == patients[i]) {
+                        found = true;
+                        break;
+                    }
+                }
+                if (!found) {
+                    queued[i] = false;
+                    removedCount++;
+                }
+            }
+
+            // every third patient leaves, as does the current top patient
+            int cancelled = 0;
+            for (int i = 0; i < 400; i += 3) {
+                if (!queued[i]) continue;
+                aQueue.cancelPatient(handles[i]);
+                queued[i] = false;
+                cancelled++;
+                result = result && (aQueue.numCancelled() <= 0.5 * (aQueue.numPatients() + aQueue.numCancelled()));
+            }
+            for (int i = 0; i < 400; i++) {
+                if (queued[i] && aQueue.peekNextPatient() == patients[i]) {
+                    aQueue.cancelPatient(handles[i]);
+                    queued[i] = false;
+                    cancelled++;
+                    break;
+                }
+            }
+            result = result && (aQueue.numPatients() == 398 - cancelled);
+            result = result && aQueue.sizeMatchesTree();
+            if (structures[s] == DARY) {
+                result = result && (aQueue.numCancelled() == 0) && aQueue.heapPropertyArray();
+            }
+            else {
+                result = result && (aQueue.numCancelled() > 0) && aQueue.heapPropertyMaxTest();
+                result = result && !aQueue.m_heap->m_dead;
+            }
+
+            // cancelled patients are skipped by the iterator and by removals
+            vector<int> expected;
+            for (int i = 0; i < 400; i++) {
+                if (queued[i]) expected.push_back(priorityFn1(patients[i]));
+            }
+            sort(expected.rbegin(), expected.rend());
+            PQueue bQueue(aQueue);
+            int count = 0;
+            for (const Patient& patient : aQueue) {
+                result = result && (priorityFn1(patient) == expected[count]);
+                count++;
+            }
+            result = result && (count == (int)expected.size());
+            vector<Patient> top;
+            result = result && (bQueue.getNextPatients(100, back_inserter(top)) == 100);
+            for (int i = 0; i < 100; i++) {
+                result = result && (priorityFn1(top[i]) == expected[i]);
+            }
+            result = result && (bQueue.numPatients() == (int)expected.size() - 100);
+            bQueue.setStructure(structures[s] == SKEW ? LEFTIST : SKEW);
+            result = result && (bQueue.numCancelled() == 0) && bQueue.sizeMatchesTree();
+            for (int i = 100; i < (int)expected.size(); i++) {
+                result = result && (priorityFn1(bQueue.getNextPatient()) == expected[i]);
+            }
+
+            // compacting leaves only the queued patients
+            aQueue.compact();
+            result = result && (aQueue.numCancelled() == 0) && aQueue.sizeMatchesTree();
+            result = result && (aQueue.numPatients() == (int)expected.size());
+            if (structures[s] == LEFTIST) {
+                result = result && aQueue.testNPL(aQueue.m_heap) && parentsMatch(aQueue.m_heap);
+            }
+            for (int i = 0; i < (int)expected.size(); i++) {
+                result = result && (priorityFn1(aQueue.getNextPatient()) == expected[i]);
+            }
+        }
+
+        // cancelling everything empties the heap
+        PQueue cQueue(priorityFn2, MINHEAP, LEFTIST);
+        cQueue.setCompactionThreshold(1);
+        vector<PatientHandle> handles;
+        for (int i = 0; i < 50; i++) {
+            handles.push_back(cQueue.insertPatient(patients[i]));
+        }
+        for (int i = 49; i >= 0; i--) {
+            cQueue.cancelPatient(handles[i]);
+        }
+        result = result && (cQueue.numPatients() == 0) && (cQueue.m_heap == nullptr);
+        result = result && (cQueue.numCancelled() == 0) && cQueue.sizeMatchesTree();
+
+        // a cancelled node that was not reclaimed yet can not be cancelled
+        // again
+        PQueue dQueue(priorityFn2, MINHEAP, SKEW);
+        handles.clear();
+        for (int i = 0; i < 10; i++) {
+            handles.push_back(dQueue.insertPatient(patients[i]));
+        }
+        PatientHandle last = handles[0];
+        for (int i = 1; i < 10; i++) {
+            if (priorityFn2(dQueue.getPatient(handles[i])) > priorityFn2(dQueue.getPatient(last))) {
+                last = handles[i];
+            }
+        }
+        dQueue.cancelPatient(last);
+        try {
+            dQueue.cancelPatient(last);
+            result = false;
+        }
+        catch(domain_error& e) {
+        }
+        result = result && (dQueue.numPatients() == 9) && (dQueue.numCancelled() == 1);
+
+        try {
+            cQueue.setCompactionThreshold(1.5);
+            result = false;
+        }
+        catch(out_of_range& e) {
+        }
+
+        return result;
+    }
+
+    // tests packing patients and queues that store packed patients
+    bool packedPatients() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+
+        bool result = (sizeof(PackedPatient) == 12);
+        result = result && (sizeof(NodeOf<PackedPatient>) < sizeof(Node));
+
+        // packing keeps everything, and a name is interned only once
+        NameTable& names = NameTable::shared();
+        for (int i = 0; i < 300; i++) {
+            PackedPatient packed(patients[i]);
+            result = result && (packed.unpack() == patients[i]) && (packed == patients[i]);
+            result = result && (names.getName(packed.getNameId()) == patients[i].getPatient());
+        }
+        int count = names.size();
+        PackedPatient first(patients[0]);
+        result = result && (names.size() == count) && (first == PackedPatient(patients[0]));
+        result = result && (PackedPatient().unpack() == Patient());
+
+        // out of range vitals still pack as long as they fit in a byte
+        Patient urgent = patients[0];
+        urgent.setBP(250);
+        result = result && (PackedPatient(urgent).getBP() == 250);
+        urgent.setBP(300);
+        try {
+            PackedPatient packed(urgent);
+            result = false;
+        }
+        catch(out_of_range& e) {
+        }
+
+        // a packed queue gives the patients back in the same order
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            PackedPQueue bQueue(priorityFn2, MINHEAP, structures[s]);
+            vector<PackedHandle> handles;
+            for (int i = 0; i < 200; i++) {
+                aQueue.insertPatient(patients[i]);
+                handles.push_back(bQueue.insertPatient(patients[i]));
+            }
+            bQueue.insertPatients(patients.begin() + 200, patients.end());
+            aQueue.insertPatients(patients.begin() + 200, patients.end());
+            result = result && (bQueue.numPatients() == 300) && bQueue.sizeMatchesTree();
+            result = result && (bQueue.peekNextPatient() == aQueue.peekNextPatient());
+
+            // handles and updates work on the packed records
+            Patient updated = patients[10];
+            updated.setOxygen(MINOX);
+            updated.setOpinion(MINOPINION);
+            aQueue.updatePatient(patients[10], updated);
+            bQueue.updatePatient(handles[10], updated);
+            result = result && (bQueue.getPatient(handles[10]) == updated);
+            result = result && bQueue.updatePatient(patients[20], patients[21]);
+            result = result && aQueue.updatePatient(patients[20], patients[21]);
+            bQueue.setPriorityFn(priorityFn1, MAXHEAP);
+            aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+            result = result && (structures[s] == DARY ? bQueue.heapPropertyArray() :
+                                structures[s] == PAIRING ? bQueue.heapPropertyPairing() :
+                                bQueue.heapPropertyMaxTest());
+
+            PackedPQueue cQueue(bQueue);
+            while (aQueue.numPatients() > 0) {
+                Patient expected = aQueue.getNextPatient();
+                Patient packed = cQueue.getNextPatient();
+                result = result && (priorityFn1(packed) == priorityFn1(expected));
+            }
+            result = result && (cQueue.numPatients() == 0) && (bQueue.numPatients() == 300);
+        }
+
+        // a batch with a patient that can not be packed leaves the queue as
+        // it was, also once a rebuild collects the nodes of the pool
+        for (int s = 0; s < 4; s++) {
+            PackedPQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            aQueue.insertPatients(patients.begin(), patients.begin() + 50);
+            vector<Patient> batch(patients.begin() + 50, patients.begin() + 60);
+            batch.push_back(urgent);
+            try {
+                aQueue.insertPatients(batch.begin(), batch.end());
+                result = false;
+            }
+            catch(out_of_range& e) {
+            }
+            result = result && (aQueue.numPatients() == 50) && aQueue.sizeMatchesTree();
+            result = result && (structures[s] == DARY ? aQueue.heapPropertyArray() :
+                                structures[s] == PAIRING ? aQueue.heapPropertyPairing() :
+                                aQueue.heapPropertyMinTest());
+            result = result && (aQueue.m_pool.liveNodes() == (structures[s] == DARY ? 0 : 50));
+            aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+            result = result && (aQueue.numPatients() == 50) && aQueue.sizeMatchesTree();
+            result = result && (structures[s] == DARY ? aQueue.heapPropertyArray() :
+                                structures[s] == PAIRING ? aQueue.heapPropertyPairing() :
+                                aQueue.heapPropertyMaxTest());
+        }
+
+        return result;
+    }
+
+    // tests a BasicPQueue gives the patients out in the same order as a
+    // PQueue with the same priority function, heap type and structure
+    template <STRUCTURE Structure>
+    bool basicQueue() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+
+        bool result = true;
+        BasicPQueue<PriorityFnOf<priorityFn2>, less<int>, Structure> aQueue;
+        PQueue bQueue(priorityFn2, MINHEAP, Structure);
+        for (int i = 0; i < 200; i++) {
+            aQueue.insertPatient(patients[i]);
+            bQueue.insertPatient(patients[i]);
+        }
+        aQueue.insertPatients(patients.begin() + 200, patients.end());
+        bQueue.insertPatients(patients.begin() + 200, patients.end());
+        result = result && (aQueue.numPatients() == 300);
+        result = result && (aQueue.peekNextPatient() == bQueue.peekNextPatient());
+        for (int i = 0; i < 100; i++) {
+            result = result && (aQueue.getNextPatient() == bQueue.getNextPatient());
+        }
+
+        // a max heap built from two merged queues
+        BasicPQueue<PriorityFnOf<priorityFn1>, greater<int>, Structure> cQueue;
+        BasicPQueue<PriorityFnOf<priorityFn1>, greater<int>, Structure> dQueue;
+        PQueue eQueue(priorityFn1, MAXHEAP, Structure);
+        PQueue fQueue(priorityFn1, MAXHEAP, Structure);
+        for (int i = 0; i < 300; i++) {
+            if (i % 2 == 0) {
+                cQueue.insertPatient(patients[i]);
+                eQueue.insertPatient(patients[i]);
+            }
+            else {
+                dQueue.insertPatient(patients[i]);
+                fQueue.insertPatient(patients[i]);
+            }
+        }
+        cQueue.mergeWithQueue(dQueue);
+        eQueue.mergeWithQueue(fQueue);
+        result = result && (cQueue.numPatients() == 300) && (dQueue.numPatients() == 0);
+        while (eQueue.numPatients() > 0) {
+            result = result && (cQueue.getNextPatient() == eQueue.getNextPatient());
+        }
+        while (bQueue.numPatients() > 0) {
+            result = result && (aQueue.getNextPatient() == bQueue.getNextPatient());
+        }
+        result = result && (aQueue.numPatients() == 0) && (cQueue.numPatients() == 0);
+
+        try {
+            aQueue.getNextPatient();
+            result = false;
+        }
+        catch(out_of_range& e) {
+        }
+        return result;
+    }
+
+    // tests scoring batches of patients with every SIMD level, and the
+    // queue rebuilds and bulk loads that use it
+    bool batchScoring() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        // not a multiple of 8, so the scalar tail is used too
+        for (int i=0;i<1003;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+
+        bool result = true;
+        PriorityPolicy policy1 = policyFn1();
+        PriorityPolicy policy2 = policyFn2();
+        PriorityPolicy weighted;
+        weighted.setWeight(TEMPERATURE, 2);
+        weighted.setWeight(OXYGEN, -1);
+        weighted.setWeight(RESPIRATORY, 3);
+        weighted.setWeight(OPINION, -5);
+        weighted.setConstant(7);
+        VitalsColumns vitals;
+        for (int i = 0; i < 1003; i++) {
+            vitals.add(patients[i]);
+        }
+        SIMDLEVEL levels[] = {SCALAR, SSE41, AVX2};
+        for (int l = 0; l < 3; l++) {
+            vector<int> keys1(1003), keys2(1003), keys3(1003);
+            scoreBatch(policy1, vitals, keys1.data(), levels[l]);
+            scoreBatch(policy2, vitals, keys2.data(), levels[l]);
+            scoreBatch(weighted, vitals, keys3.data(), levels[l]);
+            for (int i = 0; i < 1003; i++) {
+                result = result && (keys1[i] == priorityFn1(patients[i]));
+                result = result && (keys2[i] == priorityFn2(patients[i]));
+                result = result && (keys3[i] == weighted.score(patients[i]));
+            }
+        }
+
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            for (int i = 0; i < 500; i++) {
+                aQueue.insertPatient(patients[i]);
+            }
+            aQueue.setPriorityPolicy(policy1, MAXHEAP);
+            aQueue.insertPatients(patients.begin() + 500, patients.end());
+            result = result && (aQueue.numPatients() == 1003) && aQueue.heapPropertyMaxTest();
+            if (structures[s] == DARY) {
+                for (int i = 0; i < 1003; i++) {
+                    result = result && (aQueue.m_entries[i].m_key ==
+                                        priorityFn1(aQueue.m_patients[aQueue.m_entries[i].m_slot]));
+                }
+            }
+            else {
+                result = result && keysMatch(aQueue.m_heap, priorityFn1);
+            }
+
+            // back to a priority function
+            aQueue.setPriorityFn(priorityFn2, MINHEAP);
+            result = result && !aQueue.m_hasPolicy && aQueue.heapPropertyMinTest();
+            vector<int> expected;
+            for (int i = 0; i < 1003; i++) {
+                expected.push_back(priorityFn2(patients[i]));
+            }
+            sort(expected.begin(), expected.end());
+            for (int i = 0; i < 1003; i++) {
+                result = result && (priorityFn2(aQueue.getNextPatient()) == expected[i]);
+            }
+        }
+        return result;
+    }
+    bool priorityPolicies() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        VitalsColumns vitals;
+        for (int i=0;i<301;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+            vitals.add(patient);
+        }
+
+        // the original priority functions are policies
+        bool result = true;
+        for (int i = 0; i < 301; i++) {
+            result = result && (policyFn1().score(patients[i]) == priorityFn1(patients[i]));
+            result = result && (policyFn2()(patients[i]) == priorityFn2(patients[i]));
+        }
+
+        // a fever term, a low oxygen term and a clamp, batch scored at every
+        // level the same as one at a time
+        PriorityPolicy triage = policyFn1();
+        triage.addAbove(TEMPERATURE, 38, 10);
+        triage.addBelow(OXYGEN, 90, 3);
+        triage.setClamp(120, 300);
+        SIMDLEVEL levels[] = {SCALAR, SSE41, AVX2};
+        for (int l = 0; l < 3; l++) {
+            vector<int> keys(301);
+            scoreBatch(triage, vitals, keys.data(), levels[l]);
+            for (int i = 0; i < 301; i++) {
+                Patient& patient = patients[i];
+                int expected = priorityFn1(patient) + 10 * max(0, patient.getTemperature() - 38) +
+                               3 * max(0, 90 - patient.getOxygen());
+                expected = min(300, max(120, expected));
+                result = result && (keys[i] == expected) && (triage.score(patient) == expected);
+            }
+        }
+
+        // the same function built another way is equal, a different one is not
+        PriorityPolicy same;
+        same.setClamp(120, 300);
+        same.addAbove(OXYGEN, 90, 3);
+        same.addAbove(TEMPERATURE, 38, 4);
+        same.addAbove(TEMPERATURE, 38, 6);
+        same.addAbove(RESPIRATORY, 30, 2);
+        same.addAbove(RESPIRATORY, 30, -2);
+        same.setWeight(TEMPERATURE, 1);
+        same.setWeight(RESPIRATORY, 1);
+        same.setWeight(BLOODPRESSURE, 1);
+        same.setWeight(OXYGEN, -3);
+        same.setConstant(270);
+        result = result && (same == triage) && (same.getTerms().size() == 2);
+        result = result && (policyFn1() != policyFn2()) && (triage != policyFn1());
+
+        // serializing gives back an equal policy, text that is not a policy throws
+        result = result && (PriorityPolicy::deserialize(triage.serialize()) == triage);
+        result = result && (PriorityPolicy::deserialize(PriorityPolicy().serialize()) ==
+                            PriorityPolicy());
+        string bad[] = {"", "policy 2 constant 0", triage.serialize() + " 1",
+                        "policy 1 constant 0 weights 1 0 1 1 0 clamp 5 4 terms 0"};
+        for (int i = 0; i < 4; i++) {
+            try {
+                PriorityPolicy::deserialize(bad[i]);
+                result = false;
+            }
+            catch (domain_error& e) {
+            }
+        }
+        try {
+            triage.setClamp(5, 4);
+            result = false;
+        }
+        catch (out_of_range& e) {
+        }
+
+        // queues with equal policies built apart merge, a priority function
+        // with the same values does not
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(triage, MAXHEAP, structures[s]);
+            PQueue bQueue(same, MAXHEAP, structures[s]);
+            PQueue cQueue(priorityFn1, MAXHEAP, structures[s]);
+            for (int i = 0; i < 301; i++) {
+                if (i % 2 == 0) {
+                    aQueue.insertPatient(patients[i]);
+                }
+                else {
+                    bQueue.insertPatient(patients[i]);
+                }
+            }
+            aQueue.mergeWithQueue(bQueue);
+            result = result && (aQueue.numPatients() == 301) && (bQueue.numPatients() == 0);
+            result = result && aQueue.hasPriorityPolicy() && (aQueue.getPriorityFn() == nullptr);
+            try {
+                aQueue.mergeWithQueue(cQueue);
+                result = false;
+            }
+            catch (domain_error& e) {
+            }
+            try {
+                cQueue.getPriorityPolicy();
+                result = false;
+            }
+            catch (domain_error& e) {
+            }
+            int last = 1 << 30;
+            for (int i = 0; i < 301; i++) {
+                int key = triage.score(aQueue.getNextPatient());
+                result = result && (key <= last);
+                last = key;
+            }
+        }
+
+        // a packed queue scores the packed records without unpacking them,
+        // and a policy can be the priority of a BasicPQueue
+        PackedPQueue packed(policyFn2(), MINHEAP, SKEW);
+        BasicPQueue<PriorityPolicy> basic(policyFn2());
+        packed.insertPatients(patients.begin(), patients.end());
+        basic.insertPatients(patients.begin(), patients.end());
+        packed.setPriorityPolicy(policyFn1(), MAXHEAP);
+        result = result && packed.heapPropertyMaxTest() &&
+                 (packed.getPriorityPolicy() == policyFn1());
+        int last = 0;
+        for (int i = 0; i < 301; i++) {
+            int key = priorityFn2(basic.getNextPatient());
+            result = result && (key >= last);
+            last = key;
+        }
+        return result;
+    }
+    bool snapshots() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+        const string path = "pqueue_snapshot.bin";
+        bool result = true;
+
+        // every structure comes back the same, with its cancelled nodes and
+        // without calling the priority function
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue aQueue(countingPriorityFn, MINHEAP, structures[s], 3);
+            vector<PatientHandle> handles;
+            for (int i = 0; i < 300; i++) {
+                handles.push_back(aQueue.insertPatient(patients[i]));
+            }
+            for (int i = 0; i < 300; i += 7) {
+                aQueue.cancelPatient(handles[i]);
+            }
+            aQueue.getNextPatient();
+            aQueue.saveSnapshot(path);
+
+            PQueue bQueue(countingPriorityFn, MAXHEAP, SKEW);
+            bQueue.insertPatient(patients[0]);
+            int calls = priorityCalls;
+            bQueue.loadSnapshot(path);
+            result = result && (priorityCalls == calls);
+            result = result && (bQueue.getStructure() == structures[s]) &&
+                     (bQueue.getHeapType() == MINHEAP) && (bQueue.getArity() == 3) &&
+                     (bQueue.numPatients() == aQueue.numPatients()) &&
+                     (bQueue.numCancelled() == aQueue.numCancelled());
+            if (structures[s] == DARY) {
+                for (int i = 0; i < aQueue.m_size; i++) {
+                    result = result && (bQueue.m_entries[i].m_key == aQueue.m_entries[i].m_key) &&
+                             (bQueue.m_patients[bQueue.m_entries[i].m_slot] ==
+                              aQueue.m_patients[aQueue.m_entries[i].m_slot]);
+                }
+            }
+            else {
+                result = result && sameTree(aQueue.m_heap, bQueue.m_heap) &&
+                         (bQueue.m_heap->m_parent == nullptr);
+            }
+            while (aQueue.numPatients() > 0) {
+                result = result && (aQueue.getNextPatient() == bQueue.getNextPatient());
+            }
+            result = result && (bQueue.numPatients() == 0);
+        }
+
+        // a policy is saved with the queue, a priority function is not
+        PQueue policyQueue(policyFn1(), MAXHEAP, LEFTIST);
+        policyQueue.insertPatients(patients.begin(), patients.end());
+        policyQueue.saveSnapshot(path);
+        PQueue cQueue(priorityFn2, MINHEAP, SKEW);
+        cQueue.loadSnapshot(path);
+        result = result && cQueue.hasPriorityPolicy() &&
+                 (cQueue.getPriorityPolicy() == policyFn1()) &&
+                 (cQueue.getHeapType() == MAXHEAP) && cQueue.heapPropertyMaxTest();
+        PQueue functionQueue(priorityFn2, MINHEAP, SKEW);
+        functionQueue.insertPatient(patients[0]);
+        functionQueue.saveSnapshot(path);
+        try {
+            cQueue.loadSnapshot(path);
+            result = false;
+        }
+        catch (domain_error& e) {
+            result = result && (cQueue.numPatients() == 300) && cQueue.hasPriorityPolicy();
+        }
+
+        // a packed queue keeps the names, and an empty queue loads as empty
+        PackedPQueue packed(priorityFn2, MINHEAP, PAIRING);
+        packed.insertPatients(patients.begin(), patients.end());
+        packed.saveSnapshot(path);
+        PackedPQueue packedCopy(priorityFn2, MINHEAP, PAIRING);
+        packedCopy.loadSnapshot(path);
+        while (packed.numPatients() > 0) {
+            result = result && (packed.getNextPatient() == packedCopy.getNextPatient());
+        }
+        PQueue emptyQueue(priorityFn2, MINHEAP, SKEW);
+        emptyQueue.saveSnapshot(path);
+        PQueue dQueue(priorityFn2, MINHEAP, SKEW);
+        dQueue.insertPatient(patients[0]);
+        dQueue.loadSnapshot(path);
+        result = result && (dQueue.numPatients() == 0) && (dQueue.m_heap == nullptr);
+
+        // damaged snapshots throw and leave the queue as it was
+        policyQueue.saveSnapshot(path);
+        string bytes;
+        {
+            ifstream file(path.c_str(), ios::binary);
+            bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        }
+        string damaged[] = {bytes.substr(0, bytes.size() - 1), bytes.substr(0, 10),
+                            "XXXX" + bytes.substr(4), bytes + "!", ""};
+        for (int i = 0; i < 5; i++) {
+            {
+                ofstream file(path.c_str(), ios::binary | ios::trunc);
+                file << damaged[i];
+            }
+            try {
+                cQueue.loadSnapshot(path);
+                result = false;
+            }
+            catch (domain_error& e) {
+                result = result && (cQueue.numPatients() == 300) && cQueue.heapPropertyMaxTest();
+            }
+        }
+        remove(path.c_str());
+        try {
+            cQueue.loadSnapshot(path);
+            result = false;
+        }
+        catch (runtime_error& e) {
+        }
+        return result;
+    }
+    // size of the file at path in bytes, -1 if it does not exist
+    long long fileSize(const string& path) {
+        ifstream file(path.c_str(), ios::binary | ios::ate);
+        return file ? (long long)file.tellg() : -1;
+    }
+
+    // returns true if both queues hold the same heap
+    bool sameQueue(const PQueue& aQueue, const PQueue& bQueue) {
+        if (aQueue.m_structure == DARY) {
+            bool result = (aQueue.m_size == bQueue.m_size);
+            for (int i = 0; result && i < aQueue.m_size; i++) {
+                result = (aQueue.m_entries[i].m_key == bQueue.m_entries[i].m_key) &&
+                         (aQueue.m_patients[aQueue.m_entries[i].m_slot] ==
+                          bQueue.m_patients[bQueue.m_entries[i].m_slot]);
+            }
+            return result;
+        }
+        return (aQueue.m_size == bQueue.m_size) && sameTree(aQueue.m_heap, bQueue.m_heap);
+    }
+
+    bool journaledQueue() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<200;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+        const string snapshot = "pqueue_journal.snap";
+        const string journal = "pqueue_journal.log";
+        const string otherSnapshot = "pqueue_journal2.snap";
+        const string otherJournal = "pqueue_journal2.log";
+        remove(snapshot.c_str());
+        remove(journal.c_str());
+        remove(otherSnapshot.c_str());
+        remove(otherJournal.c_str());
+        bool result = true;
+
+        // every call is replayed into the same heap, in groups of 8 records
+        STRUCTURE structures[] = {SKEW, LEFTIST, PAIRING, DARY};
+        for (int s = 0; s < 4; s++) {
+            PQueue expected(priorityFn2, MINHEAP, structures[s]);
+            {
+                JournaledPQueue aQueue(priorityFn2, MINHEAP, structures[s], snapshot, journal, 8, 0);
+                for (int i = 0; i < 100; i++) {
+                    aQueue.insertPatient(patients[i]);
+                }
+                for (int i = 0; i < 30; i++) {
+                    aQueue.getNextPatient();
+                }
+                PQueue other(priorityFn2, MINHEAP, structures[s]);
+                other.insertPatients(patients.begin() + 100, patients.begin() + 120);
+                aQueue.mergeWithQueue(other);
+                result = result && (other.numPatients() == 0) && (aQueue.numPatients() == 90);
+                for (int i = 120; i < 130; i++) {
+                    aQueue.insertPatient(patients[i]);
+                }
+                aQueue.getNextPatient();
+                result = result && (aQueue.numRecords() == 142) && (aQueue.numSyncs() == 142 / 8);
+                expected = aQueue.m_queue;
+            }
+            JournaledPQueue bQueue(priorityFn2, MAXHEAP, SKEW, snapshot, journal, 8, 0);
+            result = result && sameQueue(expected, bQueue.m_queue) && (bQueue.numRecords() == 142);
+            remove(snapshot.c_str());
+            remove(journal.c_str());
+        }
+
+        // a record that was only partly written is dropped and cut off
+        PQueue expected(priorityFn2, MINHEAP, SKEW);
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 1, 0);
+            for (int i = 0; i < 50; i++) {
+                aQueue.insertPatient(patients[i]);
+            }
+            aQueue.getNextPatient();
+            result = result && (aQueue.numSyncs() == 51);
+            expected = aQueue.m_queue;
+        }
+        long long size = fileSize(journal);
+        {
+            ofstream file(journal.c_str(), ios::binary | ios::app);
+            file << string("\x01\x40\x00\x00\x00torn", 9);
+        }
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 1, 0);
+            result = result && sameQueue(expected, aQueue.m_queue) && (fileSize(journal) == size);
+        }
+
+        // compacting leaves an empty journal, and a journal from before the
+        // compaction is not applied on top of the new snapshot
+        string oldJournal;
+        {
+            ifstream file(journal.c_str(), ios::binary);
+            oldJournal.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        }
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 4, 0);
+            aQueue.compact();
+            result = result && (aQueue.numRecords() == 0) && (fileSize(journal) == 20) &&
+                     (fileSize(snapshot) > 0);
+            for (int i = 50; i < 60; i++) {
+                aQueue.insertPatient(patients[i]);
+            }
+            aQueue.getNextPatient();
+            expected = aQueue.m_queue;
+        }
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 4, 0);
+            result = result && sameQueue(expected, aQueue.m_queue) && (aQueue.numRecords() == 11);
+            aQueue.compact();
+        }
+        {
+            ofstream file(journal.c_str(), ios::binary | ios::trunc);
+            file << oldJournal;
+        }
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 4, 0);
+            result = result && sameQueue(expected, aQueue.m_queue) && (aQueue.numRecords() == 0);
+        }
+        remove(snapshot.c_str());
+        remove(journal.c_str());
+
+        // once the new snapshot is in place, a journal that can not be
+        // renamed over the old one fails the queue, so nothing more goes
+        // into the old journal
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 1, 0);
+            aQueue.insertPatient(patients[0]);
+            remove(journal.c_str());
+            mkdir(journal.c_str(), 0700);
+            ofstream((journal + "/entry").c_str()) << "x";
+            bool compactThrew = false;
+            try {
+                aQueue.compact();
+            }
+            catch (const runtime_error& e) {
+                compactThrew = true;
+            }
+            bool insertThrew = false;
+            try {
+                aQueue.insertPatient(patients[1]);
+            }
+            catch (const runtime_error& e) {
+                insertThrew = true;
+            }
+            result = result && compactThrew && insertThrew;
+        }
+        remove((journal + "/entry").c_str());
+        remove(journal.c_str());
+        remove((journal + ".tmp").c_str());
+        remove(snapshot.c_str());
+
+        // the flusher commits a group once its window is over
+        {
+            JournaledPQueue aQueue(policyFn2(), MINHEAP, PAIRING, snapshot, journal, 1000, 2000);
+            aQueue.insertPatient(patients[0]);
+            aQueue.insertPatient(patients[1]);
+            for (int i = 0; i < 100 && aQueue.numSyncs() == 0; i++) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+            result = result && (aQueue.numSyncs() == 1);
+            aQueue.getNextPatient();
+            aQueue.sync();
+            result = result && (aQueue.numSyncs() == 2);
+            expected = aQueue.m_queue;
+        }
+        {
+            JournaledPQueue aQueue(priorityFn1, MAXHEAP, SKEW, snapshot, journal, 1000, 2000);
+            result = result && (aQueue.numPatients() == 1) && sameQueue(expected, aQueue.m_queue) &&
+                     aQueue.m_queue.hasPriorityPolicy();
+        }
+        remove(snapshot.c_str());
+        remove(journal.c_str());
+
+        // merging two journaled queues moves the patients for good
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, LEFTIST, snapshot, journal, 16, 0);
+            JournaledPQueue bQueue(priorityFn2, MINHEAP, LEFTIST, otherSnapshot, otherJournal, 16, 0);
+            JournaledPQueue cQueue(priorityFn1, MINHEAP, LEFTIST, otherSnapshot + "3", otherJournal + "3", 16, 0);
+            for (int i = 0; i < 40; i++) {
+                aQueue.insertPatient(patients[i]);
+                bQueue.insertPatient(patients[i + 40]);
+            }
+            aQueue.mergeWithQueue(bQueue);
+            aQueue.mergeWithQueue(aQueue);
+            try {
+                aQueue.mergeWithQueue(cQueue);
+                result = false;
+            }
+            catch (domain_error& e) {
+            }
+            try {
+                cQueue.getNextPatient();
+                result = false;
+            }
+            catch (out_of_range& e) {
+            }
+        }
+        remove((otherSnapshot + "3").c_str());
+        remove((otherJournal + "3").c_str());
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, LEFTIST, snapshot, journal, 16, 0);
+            JournaledPQueue bQueue(priorityFn2, MINHEAP, LEFTIST, otherSnapshot, otherJournal, 16, 0);
+            result = result && (aQueue.numPatients() == 80) && (bQueue.numPatients() == 0);
+            aQueue.clear();
+        }
+        {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, LEFTIST, snapshot, journal, 16, 0);
+            result = result && (aQueue.numPatients() == 0);
+        }
+        remove(snapshot.c_str());
+        remove(journal.c_str());
+        remove(otherSnapshot.c_str());
+        remove(otherJournal.c_str());
+
+        try {
+            JournaledPQueue aQueue(priorityFn2, MINHEAP, SKEW, snapshot, journal, 0, 0);
+            result = false;
+        }
+        catch (out_of_range& e) {
+        }
+        return result;
+    }
+
+    // Parses the same patients from CSV and binary files through chunks
+    // smaller than a record, so every record is split across reads
+    bool patientLoader() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+        // longer than a chunk, so the chunk has to grow
+        patients[150].setPatient(string(200, 'x'));
+        // records 100 and 200 have vitals out of range
+        vector<Patient> records = patients;
+        records[100].setTemperature(MAXTEMP + 1);
+        records[200].setOpinion(0);
+        PQueue expected(priorityFn2, MINHEAP, LEFTIST);
+        vector<Patient> valid;
+        for (int i = 0; i < 300; i++) {
+            if (i != 100 && i != 200) {
+                valid.push_back(patients[i]);
+            }
+        }
+        for (int i = 0; i < (int)valid.size(); i += 16) {
+            expected.insertPatients(valid.begin() + i, valid.begin() + min(i + 16, (int)valid.size()));
+        }
+        const string csv = "pqueue_patients.csv";
+        const string binary = "pqueue_patients.bin";
+        bool result = true;
+
+        // a header, CRLF line ends, spaces, a blank line and no last '\n'
+        {
+            ofstream file(csv.c_str(), ios::binary);
+            file << "name,temperature,oxygen,respiratory,bp,opinion\n";
+            for (int i = 0; i < 300; i++) {
+                file << records[i].getPatient() << "," << records[i].getTemperature() << ", "
+                     << records[i].getOxygen() << " ," << records[i].getRR() << ","
+                     << records[i].getBP() << "," << records[i].getOpinion()
+                     << (i % 2 ? "\r\n" : "\n");
+                if (i == 50) {
+                    file << "\n";
+                }
+            }
+            file << "last," << MINTEMP << "," << MINOX << "," << MINRR << "," << MINBP << ",1";
+        }
+        PatientLoader csvLoader(PatientLoader::CSV, 16, 64);
+        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
+        result = result && (csvLoader.load(csv, aQueue) == 299) && (csvLoader.numRejected() == 2) &&
+                 (csvLoader.firstRejected() == 103) && (csvLoader.numBytes() == fileSize(csv));
+        valid.push_back(Patient("last", MINTEMP, MINOX, MINRR, MINBP, 1));
+        PQueue expectedCsv(priorityFn2, MINHEAP, LEFTIST);
+        for (int i = 0; i < (int)valid.size(); i += 16) {
+            expectedCsv.insertPatients(valid.begin() + i, valid.begin() + min(i + 16, (int)valid.size()));
+        }
+        result = result && sameQueue(expectedCsv, aQueue);
+        PackedPQueue packedQueue(priorityFn2, MINHEAP, LEFTIST);
+        result = result && (csvLoader.load(csv, packedQueue) == 299) && (packedQueue.numPatients() == 299);
+
+        // the binary file gives the same heap
+        PatientLoader::saveBinary(binary, records);
+        PatientLoader binaryLoader(PatientLoader::BINARY, 16, 64);
+        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
+        result = result && (binaryLoader.load(binary, bQueue) == 298) &&
+                 (binaryLoader.numRejected() == 2) && (binaryLoader.firstRejected() == 101);
+        result = result && sameQueue(expected, bQueue);
+
+        // a malformed record stops the load and keeps the patients before it
+        {
+            ofstream file(csv.c_str(), ios::binary);
+            for (int i = 0; i < 40; i++) {
+                file << patients[i].getPatient() << ",37,90,20,100,5\n";
+            }
+            file << "bad,37,90,20,100\n";
+        }
+        PQueue cQueue(priorityFn2, MINHEAP, SKEW);
+        try {
+            csvLoader.load(csv, cQueue);
+            result = false;
+        }
+        catch (domain_error& e) {
+            result = result && (cQueue.numPatients() == 40);
+        }
+        {
+            ofstream file(csv.c_str(), ios::binary);
+            file << "a,37,90,20,100,5x\n";
+        }
+        try {
+            csvLoader.load(csv, cQueue);
+            result = false;
+        }
+        catch (domain_error& e) {
+        }
+        // a binary file cut short or that is not a patient file
+        {
+            ofstream file(binary.c_str(), ios::binary | ios::app);
+            file << "abc";
+        }
+        try {
+            binaryLoader.load(binary, cQueue);
+            result = false;
+        }
+        catch (domain_error& e) {
+        }
+        try {
+            binaryLoader.load(csv, cQueue);
+            result = false;
+        }
+        catch (domain_error& e) {
+        }
+        // an exception from the queue is passed on, and the batch it was
+        // inserting is not inserted again
+        {
+            ofstream file(csv.c_str(), ios::binary);
+            for (int i = 0; i < 10; i++) {
+                file << (i == 6 ? string("Unscorable") : "Patient " + to_string(i))
+                     << ",37,90,20,100,5\n";
+            }
+        }
+        PatientLoader smallLoader(PatientLoader::CSV, 4, 64);
+        PQueue dQueue(throwOnceFn, MINHEAP, PAIRING);
+        throwOnce = true;
+        try {
+            smallLoader.load(csv, dQueue);
+            result = false;
+        }
+        catch (domain_error& e) {
+            result = result && (dQueue.numPatients() == 4) && (smallLoader.numLoaded() == 4);
+            result = result && (dQueue.m_pool.liveNodes() == 4);
+            while (dQueue.numPatients() > 0) {
+                result = result && !dQueue.getNextPatient().getPatient().empty();
+            }
+        }
+        remove(csv.c_str());
+        remove(binary.c_str());
+        try {
+            csvLoader.load(csv, cQueue);
+            result = false;
+        }
+        catch (runtime_error& e) {
+        }
+        return result;
+    }
+
+    // The histogram is checked in every build, the counters only when the
+    // tests are built with PQUEUE_STATS defined
+    bool queueStats() {
+        bool result = true;
+        StatsHistogram histogram;
+        result = result && (histogram.count() == 0) && (histogram.percentile(0.5) == 0);
+        for (int i = 1; i <= 10000; i++) {
+            histogram.record(i);
+        }
+        // within 1/16 above the exact percentile
+        uint64_t median = histogram.percentile(0.5);
+        uint64_t tail = histogram.percentile(0.99);
+        result = result && (histogram.count() == 10000) && (histogram.minValue() == 1) &&
+                 (histogram.maxValue() == 10000) && (histogram.mean() == 5000.5) &&
+                 (median >= 5000) && (median <= 5000 + 5000 / 16) &&
+                 (tail >= 9900) && (tail <= 9900 + 9900 / 16) &&
+                 (histogram.percentile(1.0) == 10000) && (histogram.percentile(0.001) == 10);
+        StatsHistogram other;
+        other.record(0);
+        other.record(1ull << 40); // past the last bucket
+        histogram.add(other);
+        result = result && (histogram.count() == 10002) && (histogram.minValue() == 0) &&
+                 (histogram.percentile(1.0) == (1ull << 40));
+        histogram.reset();
+        result = result && (histogram.count() == 0) && (histogram.maxValue() == 0);
+
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
+        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
+        PQueue cQueue(priorityFn2, MINHEAP, DARY);
+        for (int i=0;i<100;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            aQueue.insertPatient(patient);
+            bQueue.insertPatient(patient);
+            cQueue.insertPatient(patient);
+        }
+        for (int i = 0; i < 10; i++) {
+            aQueue.getNextPatient();
+            cQueue.getNextPatient();
+        }
+        aQueue.mergeWithQueue(bQueue);
+        PQueueStats stats = aQueue.getStats();
+        PQueueStats arrayStats = cQueue.getStats();
+#ifdef PQUEUE_STATS
+        // the first insert merges into an empty heap, so it is not counted
+        result = result && stats.m_enabled && (stats.m_priorityCalls == 100) &&
+                 (stats.m_nodeAllocations == 100) && (stats.m_merges == 99 + 10 + 1) &&
+                 (stats.m_mergePath.count() == stats.m_merges) &&
+                 (stats.m_mergePath.mean() * stats.m_mergePath.count() == stats.m_comparisons) &&
+                 (stats.m_nplUpdates >= stats.m_comparisons) &&
+                 (stats.m_insertNanos.count() == 100) && (stats.m_getNextNanos.count() == 10) &&
+                 (stats.m_mergeNanos.count() == 1) && (stats.m_insertNanos.maxValue() > 0);
+        result = result && (arrayStats.m_merges == 0) && (arrayStats.m_comparisons > 0) &&
+                 (arrayStats.m_nodeAllocations == 0) && (arrayStats.m_getNextNanos.count() == 10);
+        // a copy counts from its own start, the copy allocates its nodes
+        PQueue dQueue(aQueue);
+        result = result && (dQueue.getStats().m_nodeAllocations == 190) &&
+                 (dQueue.getStats().m_insertNanos.count() == 0);
+        stats += arrayStats;
+        result = result && (stats.m_priorityCalls == 200) && (stats.m_getNextNanos.count() == 20);
+        stringstream text;
+        text << stats;
+        result = result && (text.str().find("get_next_ns_p99 ") != string::npos);
+        aQueue.resetStats();
+        result = result && (aQueue.getStats().m_comparisons == 0) &&
+                 (aQueue.getStats().m_insertNanos.count() == 0);
+#else
+        result = result && !stats.m_enabled && (stats.m_merges == 0) &&
+                 (stats.m_comparisons == 0) && (stats.m_insertNanos.count() == 0) &&
+                 !arrayStats.m_enabled && (arrayStats.m_priorityCalls == 0);
+#endif
+        return result;
+    }
+
+    // the size and NPL of the subtree at node, the recursive reference for
+    // getHeapReport
+    pair<int, int> treeShape(const Node* node, int depth, long long& depthSum, int& maxDepth,
+                             int& heavy, vector<int>& nplCounts) {
+        if (node == nullptr) {
+            return make_pair(0, -1);
+        }
+        depthSum += depth;
+        maxDepth = max(maxDepth, depth);
+        pair<int, int> left = treeShape(node->m_left, depth + 1, depthSum, maxDepth, heavy, nplCounts);
+        pair<int, int> right = treeShape(node->m_right, depth + 1, depthSum, maxDepth, heavy, nplCounts);
+        if (right.first > left.first) {
+            heavy++;
+        }
+        int npl = min(left.second, right.second) + 1;
+        if (npl >= (int)nplCounts.size()) {
+            nplCounts.resize(npl + 1, 0);
+        }
+        nplCounts[npl]++;
+        return make_pair(left.first + right.first + 1, npl);
+    }
+
+    bool heapReport() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        vector<Patient> patients;
+        for (int i=0;i<500;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+        }
+        bool result = true;
+
+        // skew and leftist heaps match the recursive walk
+        STRUCTURE structures[] = {SKEW, LEFTIST};
+        for (int s = 0; s < 2; s++) {
+            PQueue aQueue(priorityFn2, MINHEAP, structures[s]);
+            for (int i = 0; i < 500; i++) {
+                aQueue.insertPatient(patients[i]);
+            }
+            for (int i = 0; i < 100; i++) {
+                aQueue.getNextPatient();
+            }
+            HeapReport report = aQueue.getHeapReport();
+            long long depthSum = 0;
+            int maxDepth = 0;
+            int heavy = 0;
+            vector<int> nplCounts;
+            treeShape(aQueue.m_heap, 0, depthSum, maxDepth, heavy, nplCounts);
+            int spine = 0;
+            for (Node* node = aQueue.m_heap; node; node = node->m_right) {
+                spine++;
+            }
+            result = result && (report.m_nodes == 400) && (report.m_rightSpine == spine) &&
+                     (report.m_maxDepth == maxDepth) && (report.m_averageDepth == depthSum / 400.0) &&
+                     (report.m_depthRatio == maxDepth / log2(401.0)) &&
+                     (report.m_nplCounts == nplCounts) && (report.m_imbalance == heavy / 400.0);
+        }
+        // a leftist heap keeps m_npl, and its right spine is its root NPL + 1
+        PQueue leftist(patients.begin(), patients.end(), priorityFn2, MAXHEAP, LEFTIST);
+        HeapReport report = leftist.getHeapReport();
+        result = result && (report.m_rightSpine == leftist.m_heap->m_npl + 1) &&
+                 ((int)report.m_nplCounts.size() == leftist.m_heap->m_npl + 1) &&
+                 (report.m_rightSpine <= log2(501.0) + 1);
+
+        // a d-ary heap of 100 with arity 4 has levels of 1, 4, 16, 64 and 15,
+        // and its last child path is 0, 4, 20, 84
+        PQueue array(patients.begin(), patients.begin() + 100, priorityFn2, MINHEAP, DARY, 4);
+        report = array.getHeapReport();
+        result = result && (report.m_nodes == 100) && (report.m_maxDepth == 4) &&
+                 (report.m_averageDepth == 2.88) && (report.m_rightSpine == 4) &&
+                 report.m_nplCounts.empty() && (report.m_imbalance == 0);
+
+        // a pairing heap is measured on its children, so a root that has
+        // only been inserted into has every other node as a child
+        PQueue pairing(priorityFn2, MINHEAP, PAIRING);
+        pairing.insertPatient(Patient("first", MINTEMP, MINOX, MINRR, MINBP, MINOPINION));
+        for (int i = 0; i < 99; i++) {
+            pairing.insertPatient(patients[i]);
+        }
+        report = pairing.getHeapReport();
+        result = result && (report.m_rightSpine == 99) && (report.m_maxDepth == 1) &&
+                 (report.m_averageDepth == 0.99) && report.m_nplCounts.empty();
+        pairing.getNextPatient();
+        report = pairing.getHeapReport();
+        result = result && (report.m_nodes == 99) && (report.m_rightSpine < 99) &&
+                 (report.m_maxDepth > 1);
+
+        PQueue empty(priorityFn2, MINHEAP, SKEW);
+        report = empty.getHeapReport();
+        result = result && (report.m_nodes == 0) && (report.m_rightSpine == 0) &&
+                 (report.m_depthRatio == 0) && report.m_nplCounts.empty();
+        return result;
+    }
+
+    // tests slabs taken over by merges are freed once their nodes are
+    // removed, so merging many small queues does not keep growing the pool
+    bool poolMergeReclaim() {
+        bool result = true;
+        PQueue central(priorityFn2, MINHEAP, LEFTIST);
+        for (int i = 0; i < 10; i++) {
+            central.insertPatient(Patient("Central " + to_string(i), 42, 70 + i, 40, 80, 1));
+        }
+        int maxSlabs = 0;
+        for (int round = 0; round < 20000 && result; round++) {
+            PQueue ward(priorityFn2, MINHEAP, LEFTIST);
+            for (int i = 0; i < 4; i++) {
+                ward.insertPatient(Patient("Ward", 42, 70 + i, 40, 80, 1));
+            }
+            central.mergeWithQueue(ward);
+            int last = 0;
+            for (int i = 0; i < 4; i++) {
+                Patient patient = central.getNextPatient();
+                result = result && (priorityFn2(patient) >= last);
+                last = priorityFn2(patient);
+            }
+            result = result && (central.numPatients() == 10);
+            maxSlabs = max(maxSlabs, (int)central.m_pool.m_slabs.size());
+        }
+        // the 10 patients left can be spread over 10 slabs, plus a spare one
+        result = result && (maxSlabs <= 11) && (central.m_pool.liveNodes() == 10);
+        while (central.numPatients() > 0) {
+            central.getNextPatient();
+        }
+        result = result && (central.m_pool.m_slabs.size() <= 2);
+        return result;
+    }
+
+    // tests setPriorityFn and setStructure rebuild with the nodes they have
+    bool rebuildReusesNodes() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, SKEW);
+        for (int i=0;i<300;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            aQueue.insertPatient(patient);
+        }
+        int allocations = aQueue.m_pool.nodeAllocations();
+
+        bool result = true;
+        aQueue.setStructure(LEFTIST);
+        result = result && aQueue.heapPropertyMinTest();
+        result = result && aQueue.testNPL(aQueue.m_heap);
+        result = result && aQueue.leftistProperty(aQueue.m_heap);
+
+        aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+        result = result && aQueue.heapPropertyMaxTest();
+        result = result && aQueue.testNPL(aQueue.m_heap);
+        result = result && aQueue.leftistProperty(aQueue.m_heap);
+        result = result && keysMatch(aQueue.m_heap, priorityFn1);
+
+        aQueue.setPriorityFn(priorityFn1, MINHEAP);
+        result = result && aQueue.heapPropertyMinTest();
+        result = result && (aQueue.numPatients() == 300) && aQueue.sizeMatchesTree();
+        result = result && (aQueue.m_pool.nodeAllocations() == allocations);
+
+        return result;
+    }
+
+    // tests the d-ary heap for a few arities, through the same public
+    // functions as the other structures
+    bool daryHeap(int arity) {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, DARY, arity);
+        vector<Patient> patients;
+        for (int i=0;i<500;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+            if (i < 300) {
+                aQueue.insertPatient(patient);
+            }
+        }
+
+        bool result = true;
+        result = result && (aQueue.m_heap == nullptr);
+        result = result && (aQueue.numPatients() == 300) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMinTest();
+
+        // removals come out in order and free slots get reused
+        int last = aQueue.m_entries[0].m_key;
+        for (int i = 0; i < 100; i++) {
+            int next = priorityFn2(aQueue.getNextPatient());
+            result = result && (next >= last);
+            last = next;
+        }
+        for (int i = 300; i < 400; i++) {
+            aQueue.insertPatient(patients[i]);
+        }
+        result = result && (aQueue.m_patients.size() == 300) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMinTest();
+
+        // update, copy and a small and a large merge
+        Patient urgent("Urgent Patient", 40, 70, 30, 120, 1);
+        urgent.setOxygen(60);
+        result = result && aQueue.updatePatient(patients[350], urgent);
+        result = result && (aQueue.m_patients[aQueue.m_entries[0].m_slot] == urgent);
+        result = result && aQueue.heapPropertyMinTest();
+
+        PQueue bQueue(aQueue);
+        result = result && (bQueue.numPatients() == 300) && bQueue.sizeMatchesTree();
+        result = result && bQueue.heapPropertyMinTest() && (bQueue.m_arity == arity);
+
+        PQueue cQueue(patients.begin() + 400, patients.begin() + 410, priorityFn2, MINHEAP, DARY, arity);
+        aQueue.mergeWithQueue(cQueue);
+        result = result && (aQueue.numPatients() == 310) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMinTest();
+        aQueue.mergeWithQueue(bQueue);
+        result = result && (aQueue.numPatients() == 610) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMinTest();
+        result = result && (bQueue.numPatients() == 0) && (cQueue.numPatients() == 0);
+
+        // rebuilds and conversions to and from the pointer based heaps
+        aQueue.setPriorityFn(priorityFn1, MAXHEAP);
+        result = result && aQueue.heapPropertyMaxTest();
+        aQueue.setArity(arity + 1);
+        result = result && aQueue.heapPropertyMaxTest();
+        aQueue.setStructure(LEFTIST);
+        result = result && (aQueue.numPatients() == 610) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMaxTest() && aQueue.testNPL(aQueue.m_heap);
+        result = result && aQueue.m_entries.empty() && aQueue.m_patients.empty();
+        aQueue.setStructure(DARY);
+        result = result && (aQueue.numPatients() == 610) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMaxTest();
+        result = result && (aQueue.m_heap == nullptr) && (aQueue.m_pool.liveNodes() == 0);
+
+        aQueue.emplacePatient("Emplaced Patient", 42, 90, 40, 160, 5);
+        result = result && (priorityFn1(aQueue.getNextPatient()) == 242);
+
+        aQueue.clear();
+        result = result && (aQueue.numPatients() == 0) && aQueue.sizeMatchesTree();
+        try {
+            aQueue.getNextPatient();
+            result = false;
+        }
+        catch(out_of_range& e) {
+        }
+
+        return result;
+    }
+
+    // tests a d-ary heap needs at least 2 children per node
+    bool daryArityError() {
+        try {
+            PQueue aQueue(priorityFn2, MINHEAP, DARY, 1);
+            return false;
+        }
+        catch(out_of_range& e) {
+        }
+
+        PQueue aQueue(priorityFn2, MINHEAP, DARY);
+        try {
+            aQueue.setArity(0);
+            return false;
+        }
+        catch(out_of_range& e) {
+        }
+
+        return aQueue.getArity() == 4;
+    }
+
+    // tests the pairing heap through the same public functions as the
+    // other structures
+    bool pairingHeap() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn1, MAXHEAP, PAIRING);
+        PQueue bQueue(priorityFn1, MAXHEAP, PAIRING);
+        vector<Patient> patients;
+        for (int i=0;i<400;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            patients.push_back(patient);
+            if (i < 300) {
+                aQueue.insertPatient(patient);
+            }
+            else {
+                bQueue.insertPatient(patient);
+            }
+        }
+
+        bool result = true;
+        result = result && (aQueue.numPatients() == 300) && aQueue.sizeMatchesTree();
+        result = result && aQueue.heapPropertyMaxTest();
+
+        // insert only links under the root, so nothing is paired yet
+        result = result && (aQueue.m_heap->m_right == nullptr);
+
+        int last = aQueue.m_heap->m_key;
+        for (int i = 0; i < 100; i++) {
+            int next = priorityFn1(aQueue.getNextPatient());
+            result = result && (next <= last);
+            last = next;
+            result = result && aQueue.heapPropertyMaxTest();
+        }
+
+        aQueue.mergeWithQueue(bQueue);
+        result = result && (aQueue.numPatients() == 300) && aQueue.sizeMatchesTree();
+        result = result && (bQueue.numPatients() == 0) && aQueue.heapPropertyMaxTest();
+
+        // updating a patient deep in the heap, then the root
+        Patient urgent("Urgent Patient", 42, 70, 40, 160, 1);
+        urgent.setBP(300);
+        result = result && aQueue.updatePatient(patients[350], urgent);
+        result = result && (aQueue.m_heap->m_patient == urgent) && aQueue.heapPropertyMaxTest();
+        result = result && aQueue.updatePatient(urgent, patients[350]);
+        result = result && aQueue.heapPropertyMaxTest() && aQueue.sizeMatchesTree();
+
+        PQueue cQueue(aQueue);
+        result = result && cQueue.heapPropertyMaxTest() && (cQueue.numPatients() == 300);
+
+        aQueue.setPriorityFn(priorityFn2, MINHEAP);
+        result = result && aQueue.heapPropertyMinTest();
+        aQueue.setStructure(DARY);
+        aQueue.setStructure(PAIRING);
+        result = result && aQueue.heapPropertyMinTest() && (aQueue.numPatients() == 300);
+        aQueue.setStructure(LEFTIST);
+        result = result && aQueue.heapPropertyMinTest() && aQueue.testNPL(aQueue.m_heap);
+
+        // sorted input gives a root with every other node as a child, the
+        // first removal pairs them all
+        PQueue dQueue(bloodPressureFn, MINHEAP, PAIRING);
+        Patient patient("Sorted Patient", 37, 100, 20, 100, 10);
+        for (int i = 0; i < 100000; i++) {
+            patient.setBP(i);
+            dQueue.insertPatient(patient);
+        }
+        for (int i = 0; i < 100; i++) {
+            result = result && (dQueue.getNextPatient().getBP() == i);
+        }
+        result = result && dQueue.heapPropertyMinTest();
+
+        return result;
+    }
+
+    // tests the concurrent queue with several threads inserting and
+    // removing at the same time
+    bool concurrentQueue() {
+        const int THREADS = 4;
+        const int PERTHREAD = 2500;
+        vector<Patient> patients;
+        {
+            Random nameGen(0,NUMNAMES-1);
+            Random temperatureGen(MINTEMP,MAXTEMP);
+            Random oxygenGen(MINOX,MAXOX);
+            Random respiratoryGen(MINRR,MAXRR);
+            Random bloodPressureGen(MINBP,MAXBP);
+            Random nurseOpinionGen(MINOPINION,MAXOPINION);
+            for (int i=0;i<THREADS*PERTHREAD;i++){
+                Patient patient(nameDB[nameGen.getRandNum()],
+                            temperatureGen.getRandNum(),
+                            oxygenGen.getRandNum(),
+                            respiratoryGen.getRandNum(),
+                            bloodPressureGen.getRandNum(),
+                            nurseOpinionGen.getRandNum());
+                patients.push_back(patient);
+            }
+        }
+
+        bool result = true;
+        ConcurrentPQueue aQueue(priorityFn2, MINHEAP, SKEW, 8);
+        vector<thread> threads;
+        for (int t = 0; t < THREADS; t++) {
+            threads.push_back(thread([&aQueue, &patients, t]() {
+                for (int i = t * PERTHREAD; i < (t + 1) * PERTHREAD; i++) {
+                    aQueue.insertPatient(patients[i]);
+                }
+            }));
+        }
+        for (int t = 0; t < THREADS; t++) {
+            threads[t].join();
+        }
+        result = result && (aQueue.numPatients() == THREADS * PERTHREAD);
+
+        // consumers drain the queue while producers are still adding to it
+        threads.clear();
+        vector<int> removed(THREADS, 0);
+        for (int t = 0; t < THREADS; t++) {
+            threads.push_back(thread([&aQueue, &patients, &removed, t]() {
+                Patient patient;
+                for (int i = 0; i < PERTHREAD / 2; i++) {
+                    aQueue.insertPatient(patients[t * PERTHREAD + i]);
+                }
+                while (aQueue.tryGetNextPatient(patient)) {
+                    removed[t]++;
+                }
+            }));
+        }
+        for (int t = 0; t < THREADS; t++) {
+            threads[t].join();
+        }
+        int total = 0;
+        for (int t = 0; t < THREADS; t++) {
+            total += removed[t];
+        }
+        result = result && (total == THREADS * PERTHREAD * 3 / 2);
+        result = result && (aQueue.numPatients() == 0);
+
+        try {
+            aQueue.getNextPatient();
+            result = false;
+        }
+        catch(out_of_range& e) {
+        }
+
+        // the strict queue gives patients in exactly the order of a PQueue
+        ConcurrentPQueue bQueue(priorityFn1, MAXHEAP, DARY, 8, STRICT);
+        PQueue cQueue(priorityFn1, MAXHEAP, LEFTIST);
+        for (int i = 0; i < 1000; i++) {
+            bQueue.insertPatient(patients[i]);
+            cQueue.insertPatient(patients[i]);
+        }
+        for (int i = 0; i < 1000; i++) {
+            result = result && (priorityFn1(bQueue.getNextPatient()) ==
+                                priorityFn1(cQueue.getNextPatient()));
+        }
+
+        // merging in a queue, then collecting every shard into one queue
+        PQueue dQueue(priorityFn1, MAXHEAP, DARY);
+        for (int i = 0; i < 500; i++) {
+            bQueue.insertPatient(patients[i]);
+            dQueue.insertPatient(patients[i + 500]);
+        }
+        bQueue.mergeWithQueue(dQueue);
+        result = result && (bQueue.numPatients() == 1000) && (dQueue.numPatients() == 0);
+        PQueue eQueue = bQueue.mergeShards();
+        result = result && (eQueue.numPatients() == 1000) && eQueue.heapPropertyArray();
+        result = result && (bQueue.numPatients() == 0);
+
+        try {
+            PQueue fQueue(priorityFn2, MINHEAP, DARY);
+            bQueue.mergeWithQueue(fQueue);
+            result = false;
+        }
+        catch(domain_error& e) {
+        }
+
+        return result;
+    }
+
+    // tests merge for normal case
+    bool mergeNormal() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
+        for (int i=0;i<1;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            aQueue.insertPatient(patient);
+        }
+
+        Random nameGen2(0,NUMNAMES-1);
+        Random temperatureGen2(MINTEMP,MAXTEMP);
+        Random oxygenGen2(MINOX,MAXOX);
+        Random respiratoryGen2(MINRR,MAXRR);
+        Random bloodPressureGen2(MINBP,MAXBP);
+        Random nurseOpinionGen2(MINOPINION,MAXOPINION);
+        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
+        for (int i=0;i<1;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            bQueue.insertPatient(patient);
+        }
+
+        aQueue.mergeWithQueue(bQueue);
+
+        return (aQueue.m_heap->m_left || aQueue.m_heap->m_right);
+    }
+
+    // tests merge with empty queue
+    bool mergeEdge() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
+        for (int i=0;i<1;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            aQueue.insertPatient(patient);
+        }
+        
+        PQueue bQueue(priorityFn2, MINHEAP, LEFTIST);
+        aQueue.mergeWithQueue(bQueue);
+
+        return (!aQueue.m_heap->m_left && !aQueue.m_heap->m_right);
+    }
+
+    // tests merge moves the size of rhs over and leaves rhs empty
+    bool mergeSize() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, SKEW);
+        PQueue bQueue(priorityFn2, MINHEAP, SKEW);
+        for (int i=0;i<14;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            if (i < 10) {
+                aQueue.insertPatient(patient);
+            }
+            else {
+                bQueue.insertPatient(patient);
+            }
+        }
+
+        aQueue.mergeWithQueue(bQueue);
+
+        bool result = true;
+        result = result && (aQueue.numPatients() == 14);
+        result = result && aQueue.sizeMatchesTree();
+        result = result && (bQueue.numPatients() == 0);
+        result = result && bQueue.sizeMatchesTree();
+
+        // the emptied queue can still be used
+        bQueue.insertPatient(aQueue.getNextPatient());
+        result = result && (aQueue.numPatients() == 13);
+        result = result && (bQueue.numPatients() == 1);
+        result = result && aQueue.sizeMatchesTree() && bQueue.sizeMatchesTree();
+
+        return result;
+    }
+
+    // tests case to merge with different structure/priority function
+    bool mergeError() {
+        Random nameGen(0,NUMNAMES-1);
+        Random temperatureGen(MINTEMP,MAXTEMP);
+        Random oxygenGen(MINOX,MAXOX);
+        Random respiratoryGen(MINRR,MAXRR);
+        Random bloodPressureGen(MINBP,MAXBP);
+        Random nurseOpinionGen(MINOPINION,MAXOPINION);
+        PQueue aQueue(priorityFn2, MINHEAP, LEFTIST);
+        PQueue bQueue(priorityFn1, MINHEAP, SKEW);
+        for (int i=0;i<1;i++){
+            Patient patient(nameDB[nameGen.getRandNum()],
+                        temperatureGen.getRandNum(),
+                        oxygenGen.getRandNum(),
+                        respiratoryGen.getRandNum(),
+                        bloodPressureGen.getRandNum(),
+                        nurseOpinionGen.getRandNum());
+            aQueue.insertPatient(patient);
+            bQueue.insertPatient(patient);
+        }
+
+        try {
+            aQueue.mergeWithQueue(bQueue);
+            return false;
+        }
+        catch(domain_error& e) {
+            return true;
+        }
+
+        return true;
+    }
+
+};
+
+
+int main() {
+    Tester test;
+
+    cout << endl;
+
+    // test constructors
+    if (test.constructorNormal()) {
+        cout << "Normal Constructor passed" << endl;
+    }
+    else {
+        cout << "Normal Constructor failed" << endl;
+    }
+
+    if (test.copyConstructorNormal()) {
+        cout << "Copy constructor normal case passed" << endl;
+    }
+    else {
+        cout << "Copy constructor normal case failed" << endl;
+    }
+
+    if (test.copyConstructorEdge()) {
+        cout << "Copy constructor edge case passed" << endl;
+    }
+    else {
+        cout << "Copy constructor edge case failed" << endl;
+    }
+    cout << endl;
+
+    // tests assignment operator cases
+    if (test.assignmentOperatorNormal()) {
+        cout << "Overloaded assignment operator normal case passed" << endl;
+    }
+    else {
+        cout << "Overloaded assignment operator normal case failed" << endl;
+    }
+
+    if (test.assignmentOperatorEdge()) {
+        cout << "Overloaded assignment operator edge case passed" << endl;
+    }
+    else {
+        cout << "Overloaded assignment operator edge case failed" << endl;
+    }
+    cout << endl;
+
+    // tests insert function
+    if (test.insertTest()) {
+        cout << "Insert function test passed" << endl;
+    }
+    else {
+        cout << "Insert function test failed" << endl;
+    }
+    cout << endl;
+
+    // tests getNextPatient function
+    if (test.removeTestNormal()) {
+        cout << "Get next patient normal test passed" << endl;
+    }
+    else {
+        cout << "Get next patient normal test failed" << endl;
+    }
+
+    if (test.removeTestError()) {
+        cout << "Get next patient error case passed" << endl;
+    }
+    else {
+        cout << "Get next patient error case failed" << endl;
+    }
+    cout << endl;
+
+    // tests insertion properties
+    if (test.insertionMinHeap()) {
+        cout << "Min heap insertion property test passed" << endl;
+    }
+    else {
+        cout << "Min heap insertion property test failed" << endl;
+    }
+
+    if (test.insertionMaxHeap()) {
+        cout << "Max heap insertion property test passed" << endl;
+    }
+    else {
+        cout << "Max heap insertion property test failed" << endl;
+    }
+    cout << endl;
+
+    // tests removal properties
+    if (test.removalMinHeap()) {
+        cout << "Min heap removal property test passed" << endl;
+    }
+    else {
+        cout << "Min heap removal property test failed" << endl;
+    }
+
+    if (test.removalMaxHeap()) {
+        cout << "Max heap removal property test passed" << endl;
+    }
+    else {
+        cout << "Max heap removal property test failed" << endl;
+    }
+    cout << endl;
+
+    // tests npl properties
+    if (test.leftistPropertyMinHeap()) {
+        cout << "Min heap leftist property passed" << endl;
+    }
+    else {
+        cout << "Min heap leftist property failed" << endl;
+    }
+
+    if (test.leftistPropertyMaxHeap()) {
+        cout << "Max heap NPL property passed" << endl;
     }
     else {
         cout << "Max heap NPL property failed" << endl;
@@ -810,6 +3241,13 @@ int main() {
     else {
         cout << "Max heap npl values failed" << endl;
     }
+
+    if (test.testNPLValueAfterRemoval()) {
+        cout << "Npl values after removal passed" << endl;
+    }
+    else {
+        cout << "Npl values after removal failed" << endl;
+    }
     cout << endl;
 
     // tests setPriority function
@@ -821,6 +3259,204 @@ int main() {
     }
     cout << endl;
 
+    // tests cached priority keys
+    if (test.cachedKeys()) {
+        cout << "Cached priority keys test passed" << endl;
+    }
+    else {
+        cout << "Cached priority keys test failed" << endl;
+    }
+
+    if (test.updatePatientTest()) {
+        cout << "Update patient test passed" << endl;
+    }
+    else {
+        cout << "Update patient test failed" << endl;
+    }
+    cout << endl;
+
+    // tests the node pool
+    if (test.poolReuse()) {
+        cout << "Node pool reuse test passed" << endl;
+    }
+    else {
+        cout << "Node pool reuse test failed" << endl;
+    }
+    cout << endl;
+
+    // tests move semantics
+    if (test.moveSemantics()) {
+        cout << "Move semantics test passed" << endl;
+    }
+    else {
+        cout << "Move semantics test failed" << endl;
+    }
+    cout << endl;
+
+    // tests degenerate skew heaps do not overflow the stack
+    if (test.stressSortedSkew(true) && test.stressSortedSkew(false)) {
+        cout << "Sorted input skew heap stress test passed" << endl;
+    }
+    else {
+        cout << "Sorted input skew heap stress test failed" << endl;
+    }
+    cout << endl;
+
+    // tests linear time heap construction
+    if (test.bulkConstructor()) {
+        cout << "Bulk constructor test passed" << endl;
+    }
+    else {
+        cout << "Bulk constructor test failed" << endl;
+    }
+
+    if (test.batchInsert()) {
+        cout << "Batch insert test passed" << endl;
+    }
+    else {
+        cout << "Batch insert test failed" << endl;
+    }
+
+    if (test.topK()) {
+        cout << "Top k test passed" << endl;
+    }
+    else {
+        cout << "Top k test failed" << endl;
+    }
+
+    if (test.peekAndIterate()) {
+        cout << "Peek and iterator test passed" << endl;
+    }
+    else {
+        cout << "Peek and iterator test failed" << endl;
+    }
+
+    if (test.handles()) {
+        cout << "Handle test passed" << endl;
+    }
+    else {
+        cout << "Handle test failed" << endl;
+    }
+
+    if (test.cancelPatients()) {
+        cout << "Cancel patients test passed" << endl;
+    }
+    else {
+        cout << "Cancel patients test failed" << endl;
+    }
+
+    if (test.packedPatients()) {
+        cout << "Packed patients test passed" << endl;
+    }
+    else {
+        cout << "Packed patients test failed" << endl;
+    }
+
+    if (test.basicQueue<SKEW>() && test.basicQueue<LEFTIST>() && test.basicQueue<PAIRING>()) {
+        cout << "Basic queue test passed" << endl;
+    }
+    else {
+        cout << "Basic queue test failed" << endl;
+    }
+
+    if (test.batchScoring()) {
+        cout << "Batch scoring test passed" << endl;
+    }
+    else {
+        cout << "Batch scoring test failed" << endl;
+    }
+
+    if (test.priorityPolicies()) {
+        cout << "Priority policies test passed" << endl;
+    }
+    else {
+        cout << "Priority policies test failed" << endl;
+    }
+
+    if (test.snapshots()) {
+        cout << "Snapshots test passed" << endl;
+    }
+    else {
+        cout << "Snapshots test failed" << endl;
+    }
+
+    if (test.journaledQueue()) {
+        cout << "Journaled queue test passed" << endl;
+    }
+    else {
+        cout << "Journaled queue test failed" << endl;
+    }
+
+    if (test.patientLoader()) {
+        cout << "Patient loader test passed" << endl;
+    }
+    else {
+        cout << "Patient loader test failed" << endl;
+    }
+
+    if (test.queueStats()) {
+        cout << "Queue stats test passed" << endl;
+    }
+    else {
+        cout << "Queue stats test failed" << endl;
+    }
+
+    if (test.heapReport()) {
+        cout << "Heap report test passed" << endl;
+    }
+    else {
+        cout << "Heap report test failed" << endl;
+    }
+
+    if (test.poolMergeReclaim()) {
+        cout << "Pool merge reclaim test passed" << endl;
+    }
+    else {
+        cout << "Pool merge reclaim test failed" << endl;
+    }
+
+    if (test.rebuildReusesNodes()) {
+        cout << "Rebuild reuses nodes test passed" << endl;
+    }
+    else {
+        cout << "Rebuild reuses nodes test failed" << endl;
+    }
+    cout << endl;
+
+    // tests the d-ary heap structure
+    if (test.daryHeap(2) && test.daryHeap(4) && test.daryHeap(8)) {
+        cout << "D-ary heap test passed" << endl;
+    }
+    else {
+        cout << "D-ary heap test failed" << endl;
+    }
+
+    if (test.daryArityError()) {
+        cout << "D-ary heap arity error case passed" << endl;
+    }
+    else {
+        cout << "D-ary heap arity error case failed" << endl;
+    }
+    cout << endl;
+
+    // tests the pairing heap structure
+    if (test.pairingHeap()) {
+        cout << "Pairing heap test passed" << endl;
+    }
+    else {
+        cout << "Pairing heap test failed" << endl;
+    }
+    cout << endl;
+
+    // tests the concurrent queue
+    if (test.concurrentQueue()) {
+        cout << "Concurrent queue test passed" << endl;
+    }
+    else {
+        cout << "Concurrent queue test failed" << endl;
+    }
+    cout << endl;
+
     // tests merge function
     if (test.mergeNormal()) {
         cout << "Merge normal case passed" << endl;
@@ -836,6 +3472,13 @@ int main() {
         cout << "Merge edge case failed" << endl;
     }
 
+    if (test.mergeSize()) {
+        cout << "Merge size test passed" << endl;
+    }
+    else {
+        cout << "Merge size test failed" << endl;
+    }
+
     if (test.mergeError()) {
         cout << "Merge error case passed" << endl;
     }
@@ -0,0 +1,341 @@
+// CMSC 341 - Fall 2023 - Project 3
+#include "patientloader.h"
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Binary patient files hold every number in the byte order of the machine
+// that wrote them:
+//   "PQPT", uint32 version, uint32 0x01020304 (shows the byte order)
+//   the patients, each one int32 temperature, oxygen, RR, BP and opinion,
+//   then the uint32 length of the name and the name
+const uint32_t PATIENTFILEVERSION = 1;
+const uint32_t PATIENTFILEORDER = 0x01020304;
+const size_t PATIENTFILEHEADER = 12;
+const size_t PATIENTRECORD = 24;      // bytes in a record with an empty name
+const uint32_t MAXNAMELENGTH = 65536; // longer names mean a damaged file
+
+// Reads an int with optional spaces around it, stopping at the first byte
+// that is not part of it.  Returns false if there are no digits or more
+// than 9 of them.
+static bool parseInt(const char*& pos, const char* end, int& value) {
+    while (pos < end && *pos == ' ') {
+        pos++;
+    }
+    bool negative = (pos < end && *pos == '-');
+    if (negative) {
+        pos++;
+    }
+    const char* digits = pos;
+    int result = 0;
+    while (pos < end && (unsigned)(*pos - '0') < 10) {
+        if (pos - digits == 9) {
+            return false;
+        }
+        result = result * 10 + (*pos - '0');
+        pos++;
+    }
+    if (pos == digits) {
+        return false;
+    }
+    while (pos < end && *pos == ' ') {
+        pos++;
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+static void putInt(string& out, uint32_t value) {
+    out.append((const char*)&value, sizeof(value));
+}
+
+PatientLoader::PatientLoader(FORMAT format, int batchSize, int chunkSize) {
+    if (batchSize < 1 || chunkSize < 1) {
+        throw out_of_range("The batch and chunk sizes must be at least 1");
+    }
+    m_format = format;
+    m_batchSize = batchSize;
+    m_chunk.resize(chunkSize);
+    m_started = false;
+    m_record = 0;
+    m_loaded = 0;
+    m_rejected = 0;
+    m_firstRejected = 0;
+    m_bytes = 0;
+}
+
+template <class Record>
+int PatientLoader::load(const string& path, PQueueOf<Record>& queue) {
+    int fd = (path == "-") ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can not read the patient file " + path);
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    try {
+        load(fd, queue);
+    }
+    catch (...) {
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+        throw;
+    }
+    if (fd != STDIN_FILENO) {
+        close(fd);
+    }
+    return m_loaded;
+}
+
+// The bytes from start to end of m_chunk are read and not parsed yet.
+// Parsing stops at a full batch or at a record that is not all read, so
+// the loop either inserts the batch or moves the partial record to the
+// front and reads behind it.  A malformed record or a failed read first
+// inserts the patients parsed before it.  An exception from the queue
+// is passed on as it is.
+template <class Record>
+int PatientLoader::load(int fd, PQueueOf<Record>& queue) {
+    m_batch.clear();
+    m_batch.reserve(m_batchSize);
+    m_started = false;
+    m_record = 0;
+    m_loaded = 0;
+    m_rejected = 0;
+    m_firstRejected = 0;
+    m_bytes = 0;
+    size_t start = 0;
+    size_t end = 0;
+    bool last = false;
+    while (true) {
+        try {
+            start += parse(m_chunk.data() + start, end - start, last);
+        }
+        catch (domain_error& e) {
+            flush(queue);
+            throw;
+        }
+        if ((int)m_batch.size() == m_batchSize) {
+            flush(queue);
+            continue;
+        }
+        if (last) {
+            break;
+        }
+        if (start > 0) {
+            memmove(m_chunk.data(), m_chunk.data() + start, end - start);
+            end -= start;
+            start = 0;
+        }
+        if (end == m_chunk.size()) {
+            m_chunk.resize(2 * m_chunk.size());
+        }
+        ssize_t count = read(fd, m_chunk.data() + end, m_chunk.size() - end);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            flush(queue);
+            throw runtime_error("Can not read the patient file");
+        }
+        last = (count == 0);
+        end += count;
+        m_bytes += count;
+    }
+    flush(queue);
+    return m_loaded;
+}
+
+// m_batch is emptied even if the queue throws, since the patients may
+// have been moved out of it already
+template <class Record>
+void PatientLoader::flush(PQueueOf<Record>& queue) {
+    try {
+        queue.insertPatients(make_move_iterator(m_batch.begin()),
+                             make_move_iterator(m_batch.end()));
+    }
+    catch (...) {
+        m_batch.clear();
+        throw;
+    }
+    m_loaded += (int)m_batch.size();
+    m_batch.clear();
+}
+
+int PatientLoader::numLoaded() const {
+    return m_loaded;
+}
+
+int PatientLoader::numRejected() const {
+    return m_rejected;
+}
+
+int PatientLoader::firstRejected() const {
+    return m_firstRejected;
+}
+
+long long PatientLoader::numBytes() const {
+    return m_bytes;
+}
+
+void PatientLoader::saveBinary(const string& path, const vector<Patient>& patients) {
+    ofstream file(path.c_str(), ios::binary | ios::trunc);
+    if (!file) {
+        throw runtime_error("Can not write the patient file " + path);
+    }
+    string buffer = "PQPT";
+    putInt(buffer, PATIENTFILEVERSION);
+    putInt(buffer, PATIENTFILEORDER);
+    for (int i = 0; i < (int)patients.size(); i++) {
+        putInt(buffer, patients[i].getTemperature());
+        putInt(buffer, patients[i].getOxygen());
+        putInt(buffer, patients[i].getRR());
+        putInt(buffer, patients[i].getBP());
+        putInt(buffer, patients[i].getOpinion());
+        const string& name = patients[i].getPatient();
+        putInt(buffer, (uint32_t)name.size());
+        buffer += name;
+        if (buffer.size() >= 65536) {
+            file.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    file.write(buffer.data(), buffer.size());
+    file.close();
+    if (file.fail()) {
+        throw runtime_error("Can not write the patient file " + path);
+    }
+}
+
+// Parses the records in data into m_batch until it is full and returns the
+// number of bytes used.  A record cut off by the end of data is left for
+// the next call, unless last says no more bytes are coming.
+size_t PatientLoader::parse(const char* data, size_t size, bool last) {
+    if (m_format == CSV) {
+        return parseCsv(data, size, last);
+    }
+    return parseBinary(data, size, last);
+}
+
+size_t PatientLoader::parseCsv(const char* data, size_t size, bool last) {
+    size_t pos = 0;
+    while (pos < size && (int)m_batch.size() < m_batchSize) {
+        const char* begin = data + pos;
+        const char* newline = (const char*)memchr(begin, '\n', size - pos);
+        if (newline == nullptr) {
+            if (!last) {
+                break;
+            }
+            newline = data + size;
+        }
+        m_record++;
+        parseLine(begin, newline);
+        pos = min(size, (size_t)(newline - data) + 1);
+    }
+    return pos;
+}
+
+void PatientLoader::parseLine(const char* begin, const char* end) {
+    if (end > begin && end[-1] == '\r') {
+        end--;
+    }
+    if (begin == end) {
+        return;
+    }
+    if (!m_started) {
+        m_started = true;
+        if (end - begin >= 4 && memcmp(begin, "name", 4) == 0) {
+            return;
+        }
+    }
+    const char* comma = (const char*)memchr(begin, ',', end - begin);
+    bool wellFormed = (comma != nullptr);
+    int vitals[NUMVITALS];
+    const char* pos = wellFormed ? comma + 1 : end;
+    for (int i = 0; i < NUMVITALS && wellFormed; i++) {
+        wellFormed = parseInt(pos, end, vitals[i]);
+        if (wellFormed && i + 1 < NUMVITALS) {
+            wellFormed = (pos < end && *pos == ',');
+            pos++;
+        }
+    }
+    if (!wellFormed || pos != end) {
+        throw domain_error("Line " + to_string(m_record) + " of the patient file is malformed");
+    }
+    addPatient(begin, comma - begin, vitals);
+}
+
+size_t PatientLoader::parseBinary(const char* data, size_t size, bool last) {
+    size_t pos = 0;
+    if (!m_started) {
+        if (size < PATIENTFILEHEADER) {
+            if (last) {
+                throw domain_error("Not a patient file");
+            }
+            return 0;
+        }
+        uint32_t version;
+        uint32_t order;
+        memcpy(&version, data + 4, sizeof(version));
+        memcpy(&order, data + 8, sizeof(order));
+        if (memcmp(data, "PQPT", 4) != 0) {
+            throw domain_error("Not a patient file");
+        }
+        if (version != PATIENTFILEVERSION) {
+            throw domain_error("The patient file has an unknown version");
+        }
+        if (order != PATIENTFILEORDER) {
+            throw domain_error("The patient file has the wrong byte order");
+        }
+        m_started = true;
+        pos = PATIENTFILEHEADER;
+    }
+    while ((int)m_batch.size() < m_batchSize && size - pos >= PATIENTRECORD) {
+        uint32_t length;
+        memcpy(&length, data + pos + PATIENTRECORD - sizeof(length), sizeof(length));
+        if (length > MAXNAMELENGTH) {
+            throw domain_error("The patient file is damaged");
+        }
+        if (size - pos - PATIENTRECORD < length) {
+            break;
+        }
+        int vitals[NUMVITALS];
+        for (int i = 0; i < NUMVITALS; i++) {
+            int32_t vital;
+            memcpy(&vital, data + pos + i * sizeof(vital), sizeof(vital));
+            vitals[i] = vital;
+        }
+        m_record++;
+        addPatient(data + pos + PATIENTRECORD, length, vitals);
+        pos += PATIENTRECORD + length;
+    }
+    if (last && pos < size && (int)m_batch.size() < m_batchSize) {
+        throw domain_error("The patient file is cut short");
+    }
+    return pos;
+}
+
+// vitals are in VITAL order
+void PatientLoader::addPatient(const char* name, size_t length, const int* vitals) {
+    if (vitals[TEMPERATURE] < MINTEMP || vitals[TEMPERATURE] > MAXTEMP ||
+        vitals[OXYGEN] < MINOX || vitals[OXYGEN] > MAXOX ||
+        vitals[RESPIRATORY] < MINRR || vitals[RESPIRATORY] > MAXRR ||
+        vitals[BLOODPRESSURE] < MINBP || vitals[BLOODPRESSURE] > MAXBP ||
+        vitals[OPINION] < MINOPINION || vitals[OPINION] > MAXOPINION) {
+        if (m_rejected++ == 0) {
+            m_firstRejected = m_record;
+        }
+        return;
+    }
+    m_batch.emplace_back(string(name, length), vitals[TEMPERATURE], vitals[OXYGEN],
+                         vitals[RESPIRATORY], vitals[BLOODPRESSURE], vitals[OPINION]);
+}
+
+// compiled here for both kinds of queues, like PQueueOf itself
+template int PatientLoader::load(const string& path, PQueueOf<Patient>& queue);
+template int PatientLoader::load(const string& path, PQueueOf<PackedPatient>& queue);
+template int PatientLoader::load(int fd, PQueueOf<Patient>& queue);
+template int PatientLoader::load(int fd, PQueueOf<PackedPatient>& queue);
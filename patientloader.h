@@ -0,0 +1,72 @@
+// CMSC 341 - Fall 2023 - Project 3
+#ifndef PATIENTLOADER_H
+#define PATIENTLOADER_H
+
+#include "pqueue.h"
+using namespace std;
+
+class PatientLoader {
+    // Streams intake records from a file or stdin into a queue.  The input
+    // is read in large chunks and parsed in place, every field is checked
+    // against MINTEMP ... MAXOPINION and the patients go into the queue
+    // batchSize at a time through insertPatients.  The name is the only
+    // string made per record, and it is moved into the Patient.
+    //
+    // CSV input has one patient per line:
+    //   name,temperature,oxygen,respiratory rate,blood pressure,opinion
+    // An optional first line starting with "name" is a header.  Blank lines
+    // and a '\r' before the '\n' are skipped, and the numbers may have
+    // spaces around them.  Names are not quoted, so they can not hold a
+    // comma.  BINARY input is the format saveBinary writes.
+    //
+    // A record that is well formed but has a vital out of range is skipped
+    // and counted in numRejected, the way the Patient constructor would
+    // turn it into an empty patient.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    enum FORMAT {CSV, BINARY};
+    // chunkSize is the size of each read, it grows if a record does not fit
+    explicit PatientLoader(FORMAT format = CSV, int batchSize = 4096,
+                           int chunkSize = 1 << 20);
+    // Reads every record in path, or stdin if path is "-", into queue and
+    // returns the number queued.  Throws runtime_error if the file can not
+    // be read and domain_error at the first malformed record, keeping the
+    // patients queued before it.
+    template <class Record>
+    int load(const string& path, PQueueOf<Record>& queue);
+    // Same, for a file descriptor that is open for reading.  fd is read to
+    // the end and not closed.
+    template <class Record>
+    int load(int fd, PQueueOf<Record>& queue);
+    // counts for the last load
+    int numLoaded() const;
+    int numRejected() const;
+    int firstRejected() const; // CSV line or BINARY record number, 0 if none
+    long long numBytes() const;
+    // Writes patients to path in the BINARY format.  Throws runtime_error
+    // if the file can not be written.
+    static void saveBinary(const string& path, const vector<Patient>& patients);
+
+private:
+    FORMAT m_format;
+    int m_batchSize;
+    vector<char> m_chunk;    // bytes read and not parsed yet
+    vector<Patient> m_batch; // parsed patients waiting for insertPatients
+    bool m_started;          // the header was read, or the first CSV line
+    int m_record;            // CSV line or BINARY record parsed last
+    int m_loaded;
+    int m_rejected;
+    int m_firstRejected;
+    long long m_bytes;
+
+    template <class Record>
+    void flush(PQueueOf<Record>& queue); // inserts m_batch
+    size_t parse(const char* data, size_t size, bool last);
+    size_t parseCsv(const char* data, size_t size, bool last);
+    size_t parseBinary(const char* data, size_t size, bool last);
+    void parseLine(const char* begin, const char* end);
+    void addPatient(const char* name, size_t length, const int* vitals);
+};
+
+#endif
@@ -1,54 +1,181 @@
 // CMSC 341 - Fall 2023 - Project 3
 #include "pqueue.h"
-PQueue::PQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure) {
+#include <cassert>
+#include <new>
+#include <algorithm>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+// SIMD batch scoring is only compiled where the target attributes and
+// __builtin_cpu_supports are available
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PQUEUE_X86_SIMD
+#include <immintrin.h>
+#endif
+// snapshots are mapped into memory where there is mmap, read otherwise
+#if defined(__unix__) || defined(__APPLE__)
+#define PQUEUE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+template <class Record>
+PQueueOf<Record>::PQueueOf(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, int arity) {
+    if (arity < 2) {
+        throw out_of_range("A d-ary heap needs at least 2 children per node");
+    }
+
     m_heap = nullptr;
     m_size = 0;
+    m_cancelled = 0;
+    m_compactThreshold = 0.25;
     m_priorFunc = priFn;
     m_heapType = heapType;
     m_structure = structure;
-}
-PQueue::~PQueue() {
-    deleteSubTree(m_heap);
+    m_arity = arity;
+    m_hasPolicy = false;
 }
 
-// recursively deletes each node in tree
-void PQueue::deleteSubTree(Node* ptr) {
-    if (ptr) {
-        deleteSubTree(ptr->m_left);
-        deleteSubTree(ptr->m_right);
-        delete ptr;
-    }
+template <class Record>
+PQueueOf<Record>::PQueueOf(const PriorityPolicy& policy, HEAPTYPE heapType,
+                           STRUCTURE structure, int arity)
+    : PQueueOf(nullptr, heapType, structure, arity) {
+    m_policy = policy;
+    m_hasPolicy = true;
+}
+// the pool frees its slabs when it is destroyed
+template <class Record>
+PQueueOf<Record>::~PQueueOf() {
 }
 
-void PQueue::clear() {
-    deleteSubTree(m_heap);
+// every node belongs to m_pool, so the whole tree goes at once
+template <class Record>
+void PQueueOf<Record>::clear() {
+    m_pool.releaseAll();
+    clearArray();
     m_heap = nullptr;
     m_size = 0;
+    m_cancelled = 0;
 }
 
-PQueue::PQueue(const PQueue& rhs) {
+template <class Record>
+PQueueOf<Record>::PQueueOf(const PQueueOf& rhs) {
     m_priorFunc = rhs.m_priorFunc;
     m_heapType = rhs.m_heapType;
     m_structure = rhs.m_structure;
+    m_arity = rhs.m_arity;
+    m_policy = rhs.m_policy;
+    m_hasPolicy = rhs.m_hasPolicy;
     m_size = rhs.m_size;
+    m_cancelled = rhs.m_cancelled;
+    m_compactThreshold = rhs.m_compactThreshold;
     m_heap = copyTree(rhs.m_heap);
+    copyArray(rhs);
 }
 
-// recursively goes through and adds left and right children
-Node* PQueue::copyTree(const Node* ptr) {
+// goes through the tree with a stack of (original, copy) pairs and adds
+// copies of the left and right children
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::copyTree(const Node* ptr) {
     if (ptr == nullptr) {
         return  nullptr;
     }
 
-    Node* temp = new Node(ptr->getPatient());
-    temp->m_npl = ptr->m_npl;
-    temp->m_left = copyTree(ptr->m_left);
-    temp->m_right = copyTree(ptr->m_right);
+    Node* root = m_pool.allocate(ptr->m_patient, ptr->m_key);
+    PQUEUE_COUNT(m_nodeAllocations, 1);
+    root->m_npl = ptr->m_npl;
+    root->m_dead = ptr->m_dead;
+
+    vector<pair<const Node*, Node*> > stack;
+    stack.push_back(make_pair(ptr, root));
+    while (!stack.empty()) {
+        const Node* original = stack.back().first;
+        Node* temp = stack.back().second;
+        stack.pop_back();
+
+        if (original->m_left) {
+            temp->m_left = m_pool.allocate(original->m_left->m_patient, original->m_left->m_key);
+            PQUEUE_COUNT(m_nodeAllocations, 1);
+            temp->m_left->m_npl = original->m_left->m_npl;
+            temp->m_left->m_parent = temp;
+            temp->m_left->m_dead = original->m_left->m_dead;
+            stack.push_back(make_pair(original->m_left, temp->m_left));
+        }
+        if (original->m_right) {
+            temp->m_right = m_pool.allocate(original->m_right->m_patient, original->m_right->m_key);
+            PQUEUE_COUNT(m_nodeAllocations, 1);
+            temp->m_right->m_npl = original->m_right->m_npl;
+            temp->m_right->m_parent = temp;
+            temp->m_right->m_dead = original->m_right->m_dead;
+            stack.push_back(make_pair(original->m_right, temp->m_right));
+        }
+    }
+
+    return root;
+}
 
-    return temp;
+template <class Record>
+PQueueOf<Record>::PQueueOf(PQueueOf&& rhs) noexcept {
+    m_priorFunc = rhs.m_priorFunc;
+    m_heapType = rhs.m_heapType;
+    m_structure = rhs.m_structure;
+    m_arity = rhs.m_arity;
+    m_policy = std::move(rhs.m_policy);
+    m_hasPolicy = rhs.m_hasPolicy;
+    m_size = rhs.m_size;
+    m_cancelled = rhs.m_cancelled;
+    m_compactThreshold = rhs.m_compactThreshold;
+    m_heap = rhs.m_heap;
+    m_pool.swap(rhs.m_pool);
+    m_entries = std::move(rhs.m_entries);
+    m_patients = std::move(rhs.m_patients);
+    m_freeSlots = std::move(rhs.m_freeSlots);
+    m_positions = std::move(rhs.m_positions);
+
+    rhs.m_heap = nullptr;
+    rhs.m_size = 0;
+    rhs.m_cancelled = 0;
+    rhs.clearArray();
+}
+
+template <class Record>
+PQueueOf<Record>& PQueueOf<Record>::operator=(PQueueOf&& rhs) noexcept {
+    // protects from self-assignment
+    if (this == &rhs) {
+        return *this;
+    }
+
+    clear();
+
+    m_size = rhs.m_size;
+    m_cancelled = rhs.m_cancelled;
+    m_compactThreshold = rhs.m_compactThreshold;
+    m_priorFunc = rhs.m_priorFunc;
+    m_heapType = rhs.m_heapType;
+    m_structure = rhs.m_structure;
+    m_arity = rhs.m_arity;
+    m_policy = std::move(rhs.m_policy);
+    m_hasPolicy = rhs.m_hasPolicy;
+    m_heap = rhs.m_heap;
+    // clear emptied this pool, so rhs is left with an empty one
+    m_pool.swap(rhs.m_pool);
+    m_entries = std::move(rhs.m_entries);
+    m_patients = std::move(rhs.m_patients);
+    m_freeSlots = std::move(rhs.m_freeSlots);
+    m_positions = std::move(rhs.m_positions);
+
+    rhs.m_heap = nullptr;
+    rhs.m_size = 0;
+    rhs.m_cancelled = 0;
+    rhs.clearArray();
+
+    return *this;
 }
 
-PQueue& PQueue::operator=(const PQueue& rhs) {
+template <class Record>
+PQueueOf<Record>& PQueueOf<Record>::operator=(const PQueueOf& rhs) {
     // protects from self-assignment
     if (this == &rhs) {
         return *this;
@@ -57,90 +184,133 @@ PQueue& PQueue::operator=(const PQueue& rhs) {
     clear();
 
     m_size = rhs.m_size;
+    m_cancelled = rhs.m_cancelled;
+    m_compactThreshold = rhs.m_compactThreshold;
     m_priorFunc = rhs.m_priorFunc;
     m_heapType = rhs.m_heapType;
     m_structure = rhs.m_structure;
+    m_arity = rhs.m_arity;
+    m_policy = rhs.m_policy;
+    m_hasPolicy = rhs.m_hasPolicy;
 
     if (rhs.m_heap != nullptr) {
         m_heap = copyTree(rhs.m_heap);
     }
+    copyArray(rhs);
 
     return *this;
 }
 
-void PQueue::mergeWithQueue(PQueue& rhs) {
+template <class Record>
+void PQueueOf<Record>::mergeWithQueue(PQueueOf& rhs) {
+    PQUEUE_TIME(m_mergeNanos);
     // protects from self-merging
     if (this == &rhs) {
         return;
     }
 
     // protects from merging with 2 different priority functions
-    if (m_priorFunc != rhs.m_priorFunc || m_structure != rhs.m_structure) {
+    if (!samePriority(rhs) || m_structure != rhs.m_structure) {
         throw domain_error("Queues have different structures or types");
     }
 
-    // merges differently depending on structure
-    if (m_structure == SKEW) {
-        m_heap = mergeSkew(m_heap, rhs.m_heap);
-    }
-    else if (m_structure == LEFTIST) {
-        m_heap = mergeLeftist(m_heap, rhs.m_heap);
-        updateNPL(m_heap);
+    if (m_structure == DARY) {
+        for (int i = 0; i < rhs.m_size; i++) {
+            appendEntry(std::move(rhs.m_patients[rhs.m_entries[i].m_slot]),
+                        rhs.m_entries[i].m_key);
+        }
+        siftAppended(rhs.m_size);
+        rhs.clearArray();
+        rhs.m_size = 0;
+        return;
     }
-    rhs.m_heap = nullptr;  
-}
 
-Node* PQueue::mergeSkew(Node* p1, Node* p2) {
-    if (!p1) return p2;
-    if (!p2) return p1;
+    // rhs hands over all of its nodes, so it hands over its size and the
+    // slabs the nodes live in too
+    m_heap = mergeNodes(m_heap, rhs.m_heap);
+    m_size += rhs.m_size;
+    m_cancelled += rhs.m_cancelled;
+    m_pool.adopt(rhs.m_pool);
+    rhs.m_heap = nullptr;
+    rhs.m_size = 0;
+    rhs.m_cancelled = 0;
+}
 
-    // swaps if needed
-    if (m_heapType == MINHEAP) {
-        if (m_priorFunc(p1->m_patient) > m_priorFunc(p2->m_patient)) {
-            swap(p1, p2);
-        }
+// merges differently depending on structure, the result is a root so it
+// has no parent.  With PQUEUE_STATS a skew or leftist merge records its
+// comparisons as the length of the merge path, and a leftist merge fixes
+// the NPL of every node on it.
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::mergeNodes(Node* p1, Node* p2) {
+#ifdef PQUEUE_STATS
+    long long comparisons = m_stats.m_comparisons;
+    bool counted = (p1 && p2);
+#endif
+    Node* root;
+    if (m_structure == SKEW) {
+        root = mergeSkew(p1, p2);
+    }
+    else if (m_structure == PAIRING) {
+        root = mergePairing(p1, p2);
     }
     else {
-        if (m_priorFunc(p1->m_patient) < m_priorFunc(p2->m_patient)) {
-            swap(p1, p2);
-        }    
+        root = mergeLeftist(p1, p2);
     }
-
-    // adds it to right side, then swaps left and right children of p1 so it's on the left
-    p1->m_right = mergeSkew(p1->m_right, p2);
-    swap(p1->m_left, p1->m_right);
-
-    return p1;
+    if (root) {
+        root->m_parent = nullptr;
+    }
+#ifdef PQUEUE_STATS
+    if (counted) {
+        long long path = m_stats.m_comparisons - comparisons;
+        m_stats.m_merges++;
+        if (m_structure != PAIRING) {
+            m_stats.m_mergePath.record(path);
+        }
+        if (m_structure == LEFTIST) {
+            m_stats.m_nplUpdates += path;
+        }
+    }
+#endif
+    return root;
 }
 
-Node* PQueue::mergeLeftist(Node* p1, Node* p2) {
-    if (!p1) return p2;
-    if (!p2) return p1;
-
-    // swaps if needed
+// The kernels are picked by the heap type once per merge
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::mergePairing(Node* p1, Node* p2) {
     if (m_heapType == MINHEAP) {
-        if (m_priorFunc(p1->m_patient) > m_priorFunc(p2->m_patient)) {
-            swap(p1, p2);
-        }
-    }
-    else {
-        if (m_priorFunc(p1->m_patient) < m_priorFunc(p2->m_patient)) {
-            swap(p1, p2);
-        }    
+        return HeapKernels::mergePairing(p1, p2, PQUEUE_ORDER(MinFirst));
     }
+    return HeapKernels::mergePairing(p1, p2, PQUEUE_ORDER(MaxFirst));
+}
 
-    // adds it to right side, then swaps left and right children of p1 if needed
-    p1->m_right = mergeLeftist(p1->m_right, p2);
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::combineSiblings(Node* first) {
+    PQUEUE_COUNT(m_merges, 1);
+    if (m_heapType == MINHEAP) {
+        return HeapKernels::combineSiblings(first, m_mergePath, PQUEUE_ORDER(MinFirst));
+    }
+    return HeapKernels::combineSiblings(first, m_mergePath, PQUEUE_ORDER(MaxFirst));
+}
 
-    if (!p1->m_left || (p1->m_left->m_npl < p1->m_right->m_npl)) {
-        swap(p1->m_left, p1->m_right);
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::mergeSkew(Node* p1, Node* p2) {
+    if (m_heapType == MINHEAP) {
+        return HeapKernels::mergeSkew(p1, p2, PQUEUE_ORDER(MinFirst));
     }
+    return HeapKernels::mergeSkew(p1, p2, PQUEUE_ORDER(MaxFirst));
+}
 
-    return p1;
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::mergeLeftist(Node* p1, Node* p2) {
+    if (m_heapType == MINHEAP) {
+        return HeapKernels::mergeLeftist(p1, p2, m_mergePath, PQUEUE_ORDER(MinFirst));
+    }
+    return HeapKernels::mergeLeftist(p1, p2, m_mergePath, PQUEUE_ORDER(MaxFirst));
 }
 
 // return minimum of 2 ints
-int PQueue::min(int x, int y) {
+template <class Record>
+int PQueueOf<Record>::min(int x, int y) {
     if (x < y) {
         return x;
     }
@@ -150,7 +320,8 @@ int PQueue::min(int x, int y) {
 }
 
 // return npl or -1 if nullptr
-int PQueue::NPL(Node* ptr) {
+template <class Record>
+int PQueueOf<Record>::NPL(Node* ptr) {
     if (ptr == nullptr) {
         return -1;
     }
@@ -158,242 +329,2468 @@ int PQueue::NPL(Node* ptr) {
     return ptr->m_npl;
 }
 
-// recursively updates npl for every node in tree
-void PQueue::updateNPL(Node* ptr) {
-    // makes sure no seg faults
-    if (ptr == nullptr) {
-        return;
-    }
-
-    // traverses to left and right of tree
-    updateNPL(ptr->m_left);
-    updateNPL(ptr->m_right);
 
-    int leftNPL = NPL(ptr->m_left);
-    int rightNPL = NPL(ptr->m_right);
+template <class Record>
+HandleOf<Record> PQueueOf<Record>::insertPatient(const Patient& patient) {
+    PQUEUE_TIME(m_insertNanos);
+    if (m_structure == DARY) {
+        return Handle(nullptr, insertEntry(Record(patient), priorityOf(patient)));
+    }
 
-    ptr->m_npl = min(leftNPL, rightNPL) + 1;
+    // creates the node to be inserted from the pool and merges it in as a
+    // one node heap
+    Node* newNode = m_pool.allocate(patient, priorityOf(patient));
+    PQUEUE_COUNT(m_nodeAllocations, 1);
+    m_heap = mergeNodes(m_heap, newNode);
+    m_size++;
+    return Handle(newNode, -1);
 }
 
+template <class Record>
+void PQueueOf<Record>::insertPatients(const Patient* patients, int count) {
+    insertPatients(patients, patients + count);
+}
 
-void PQueue::insertPatient(const Patient& patient) {
-    // creates the node to be inserted and adds it as root of new PQueue
-    Node* newNode = new Node(patient);
-    PQueue temp(m_priorFunc, m_heapType, m_structure);
-    temp.m_heap = newNode;
+// the key is computed before the patient is moved into the node
+template <class Record>
+HandleOf<Record> PQueueOf<Record>::insertPatient(Patient&& patient) {
+    PQUEUE_TIME(m_insertNanos);
+    int key = priorityOf(patient);
+    if (m_structure == DARY) {
+        return Handle(nullptr, insertEntry(Record(std::move(patient)), key));
+    }
 
-    // merges our queue with new one
-    mergeWithQueue(temp);
+    Node* newNode = m_pool.allocate(std::move(patient), key);
+    PQUEUE_COUNT(m_nodeAllocations, 1);
+    m_heap = mergeNodes(m_heap, newNode);
     m_size++;
+    return Handle(newNode, -1);
 }
 
-// count is passed in by reference so it goes up for every node
-int PQueue::numPatients() const {
-    int count = 0;
-    countPatients(m_heap, count);
-    return count;
-}
+template <class Record>
+bool PQueueOf<Record>::updatePatient(const Patient& patient, const Patient& updated) {
+    if (m_structure == DARY) {
+        for (int i = 0; i < m_size; i++) {
+            Record& current = m_patients[m_entries[i].m_slot];
+            if (current == patient) {
+                current = Record(updated);
+                moveEntry(i, priorityOf(updated));
+                return true;
+            }
+        }
+        return false;
+    }
 
-// iterates through tree and increases count for each node
-void PQueue::countPatients(Node* ptr, int& count) const {
-    if (ptr != nullptr) {
-        count++;
-        countPatients(ptr->m_left, count);
-        countPatients(ptr->m_right, count);
+    Node* found = findMatch(patient);
+    if (found == nullptr) {
+        return false;
     }
-}
 
-prifn_t PQueue::getPriorityFn() const {
-    return m_priorFunc;
+    // the detached node is reused with a fresh key and merged back in
+    detachNode(found);
+    found->m_patient = Record(updated);
+    found->m_key = priorityOf(updated);
+    m_heap = mergeNodes(m_heap, found);
+    purgeTop();
+
+    return true;
 }
 
-Patient PQueue::getNextPatient() {
-    if (m_size == 0) {
-        throw out_of_range("The heap is empty");
+template <class Record>
+void PQueueOf<Record>::updatePatient(Handle handle, const Patient& updated) {
+    checkHandle(handle);
+    if (m_structure == DARY) {
+        m_patients[handle.m_slot] = Record(updated);
+        moveEntry(m_positions[handle.m_slot], priorityOf(updated));
+        return;
     }
 
-    // stores original root to return the patient later
-    Patient temp = m_heap->m_patient;
+    Node* node = handle.m_node;
+    detachNode(node);
+    node->m_patient = Record(updated);
+    node->m_key = priorityOf(updated);
+    m_heap = mergeNodes(m_heap, node);
+    purgeTop();
+}
 
-    // removes root node
-    m_heap = removeRoot(m_heap);
-    m_size--;
+template <class Record>
+Patient PQueueOf<Record>::removePatient(Handle handle) {
+    checkHandle(handle);
+    if (m_structure == DARY) {
+        return removeEntry(m_positions[handle.m_slot]);
+    }
 
+    Node* node = handle.m_node;
+    detachNode(node);
+    Patient temp = asPatient(std::move(node->m_patient));
+    m_pool.release(node);
+    m_size--;
+    purgeTop();
     return temp;
 }
 
-Node* PQueue::removeRoot(Node* ptr) {
-    if (ptr == nullptr) {
-        return nullptr;
+template <class Record>
+const Record& PQueueOf<Record>::getPatient(Handle handle) const {
+    checkHandle(handle);
+    if (m_structure == DARY) {
+        return m_patients[handle.m_slot];
     }
+    return handle.m_node->m_patient;
+}
 
-    // creates the new root to be merged
-    Node* newRoot;
+// A node handle can not be checked against the pool without a search, so
+// only its kind and whether it was cancelled are checked.  A slot handle
+// must be a slot in use.
+template <class Record>
+void PQueueOf<Record>::checkHandle(Handle handle) const {
+    if (m_structure == DARY) {
+        if (handle.m_slot < 0 || handle.m_slot >= (int)m_positions.size() ||
+            m_positions[handle.m_slot] < 0) {
+            throw domain_error("The handle does not refer to a queued patient");
+        }
+    }
+    else if (handle.m_node == nullptr || handle.m_node->m_dead) {
+        throw domain_error("The handle does not refer to a queued patient");
+    }
+}
 
-    // merges differently depending on structure
-    if (m_structure == SKEW) {
-        newRoot = mergeSkew(ptr->m_left, ptr->m_right);
-        m_heap = newRoot;
+template <class Record>
+void PQueueOf<Record>::cancelPatient(Handle handle) {
+    checkHandle(handle);
+    if (m_structure == DARY) {
+        // removing an entry is already O(log n) and leaves no hole
+        removePatient(handle);
+        return;
     }
-    else if (m_structure == LEFTIST) {
-        newRoot = mergeLeftist(ptr->m_left, ptr->m_right);
-        m_heap = newRoot;
-        updateNPL(newRoot);
+
+    handle.m_node->m_dead = true;
+    m_cancelled++;
+    purgeTop();
+    if (m_cancelled > m_compactThreshold * m_size) {
+        compact();
     }
+}
 
-    // deletes original root
-    delete ptr;
+template <class Record>
+void PQueueOf<Record>::compact() {
+    if (m_cancelled == 0) {
+        return;
+    }
 
-    return newRoot;
+    vector<Node*> nodes;
+    collectLive(nodes);
+    m_heap = heapify(nodes);
 }
 
-void PQueue::setPriorityFn(prifn_t priFn, HEAPTYPE heapType) {
-    if (m_heapType == heapType && m_priorFunc == priFn) return;
+template <class Record>
+double PQueueOf<Record>::getCompactionThreshold() const {
+    return m_compactThreshold;
+}
 
-    // creates a new queue with different heaptype and inserts all the nodes
-    PQueue temp(priFn, heapType, m_structure);
-    temp.insertWithDiffStructure(m_heap, temp);
+template <class Record>
+void PQueueOf<Record>::setCompactionThreshold(double threshold) {
+    if (threshold < 0 || threshold > 1) {
+        throw out_of_range("The compaction threshold must be between 0 and 1");
+    }
+    m_compactThreshold = threshold;
+}
 
-    *this = temp;
+template <class Record>
+int PQueueOf<Record>::numCancelled() const {
+    return m_cancelled;
 }
 
-void PQueue::insertWithDiffStructure(Node* ptr, PQueue& temp) {
-    if (ptr != nullptr) {
-        insertWithDiffStructure(ptr->m_left, temp);
-        temp.insertPatient(ptr->m_patient);
-        insertWithDiffStructure(ptr->m_right, temp);
+// pops cancelled nodes off the top, so the root is always a live patient
+// and the heap is empty once every patient left was cancelled
+template <class Record>
+void PQueueOf<Record>::purgeTop() {
+    while (m_heap != nullptr && m_heap->m_dead) {
+        removeRoot(m_heap);
+        m_size--;
+        m_cancelled--;
     }
 }
 
-void PQueue::setStructure(STRUCTURE structure){
-    if (m_structure == structure) return;
+// puts the live nodes in nodes and gives the cancelled ones back to the
+// pool, for rebuilds that go through every node anyway
+template <class Record>
+void PQueueOf<Record>::collectLive(vector<Node*>& nodes) {
+    m_pool.collect(nodes);
+    if (m_cancelled == 0) {
+        return;
+    }
+
+    int live = 0;
+    for (int i = 0; i < (int)nodes.size(); i++) {
+        if (nodes[i]->m_dead) {
+            m_pool.release(nodes[i]);
+        }
+        else {
+            nodes[live++] = nodes[i];
+        }
+    }
+    nodes.resize(live);
+    m_size = live;
+    m_cancelled = 0;
+}
 
-    // creates a new queue with different structure and inserts all the nodes
-    PQueue temp(m_priorFunc, m_heapType, structure);
-    temp.insertWithDiffStructure(m_heap, temp);
+// returns the first node in preorder whose patient equals patient
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::findMatch(const Patient& patient) const {
+    vector<Node*> stack;
+    if (m_heap != nullptr) {
+        stack.push_back(m_heap);
+    }
+
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        if (!node->m_dead && node->m_patient == patient) {
+            return node;
+        }
+        if (node->m_right) stack.push_back(node->m_right);
+        if (node->m_left) stack.push_back(node->m_left);
+    }
 
-    *this = temp;
+    return nullptr;
 }
 
+// Takes node out of the heap and leaves it as a one node heap, the merge of
+// its children takes its place.  m_parent leads back up without a search,
+// and for leftist heaps the npl values are fixed on the way up, stopping
+// at the first ancestor whose npl does not change.
+template <class Record>
+void PQueueOf<Record>::detachNode(Node* node) {
+    Node* parent = node->m_parent;
+    if (m_structure == PAIRING) {
+        // the node leaves its sibling list and its children are paired
+        // into a heap that is melded back with the rest
+        Node* children = combineSiblings(node->m_left);
+        if (parent == nullptr) {
+            m_heap = children;
+        }
+        else {
+            if (parent->m_left == node) {
+                parent->m_left = node->m_right;
+            }
+            else {
+                parent->m_right = node->m_right;
+            }
+            if (node->m_right) {
+                node->m_right->m_parent = parent;
+            }
+            m_heap = mergeNodes(m_heap, children);
+        }
+    }
+    else {
+        Node* rest = mergeNodes(node->m_left, node->m_right);
+        if (parent == nullptr) {
+            m_heap = rest;
+        }
+        else {
+            if (parent->m_left == node) {
+                parent->m_left = rest;
+            }
+            else {
+                parent->m_right = rest;
+            }
+            if (rest) {
+                rest->m_parent = parent;
+            }
+        }
 
-STRUCTURE PQueue::getStructure() const {
-    return m_structure;
+        if (m_structure == LEFTIST) {
+            for (Node* ptr = parent; ptr; ptr = ptr->m_parent) {
+                if (NPL(ptr->m_left) < NPL(ptr->m_right)) {
+                    swap(ptr->m_left, ptr->m_right);
+                }
+                int npl = NPL(ptr->m_right) + 1;
+                if (npl == ptr->m_npl) {
+                    break;
+                }
+                ptr->m_npl = npl;
+                PQUEUE_COUNT(m_nplUpdates, 1);
+            }
+        }
+    }
+
+    node->m_left = nullptr;
+    node->m_right = nullptr;
+    node->m_parent = nullptr;
+    node->m_npl = 0;
 }
 
-HEAPTYPE PQueue::getHeapType() const {
-    return m_heapType;
+// m_size and m_cancelled are kept up to date by every operation, so this is
+// O(1).  Building with PQUEUE_DEBUG defined checks m_size against the tree
+// on every call.
+template <class Record>
+int PQueueOf<Record>::numPatients() const {
+#ifdef PQUEUE_DEBUG
+    assert(sizeMatchesTree());
+#endif
+    return m_size - m_cancelled;
 }
 
-void PQueue::printPatientQueue() const {
-    preOrder(m_heap);
+// count is passed in by reference so it goes up for every node
+template <class Record>
+bool PQueueOf<Record>::sizeMatchesTree() const {
+    if (m_structure == DARY) {
+        return (int)m_entries.size() == m_size &&
+               (int)(m_patients.size() - m_freeSlots.size()) == m_size;
+    }
+
+    int count = 0;
+    countPatients(m_heap, count);
+    return count == m_size;
 }
 
-void PQueue::preOrder(Node* node) const {
-    if (node != nullptr) {
-        cout << "[" << m_priorFunc(node->m_patient) << "] " << node->m_patient << endl;
-        preOrder(node->m_left);
-        preOrder(node->m_right);
+// iterates through tree with a stack and increases count for each node
+template <class Record>
+void PQueueOf<Record>::countPatients(Node* ptr, int& count) const {
+    vector<Node*> stack;
+    if (ptr != nullptr) {
+        stack.push_back(ptr);
+    }
+    while (!stack.empty()) {
+        Node* node = stack.back();
+        stack.pop_back();
+        count++;
+        if (node->m_left) stack.push_back(node->m_left);
+        if (node->m_right) stack.push_back(node->m_right);
     }
 }
 
-void PQueue::dump() const {
-  if (m_size == 0) {
-    cout << "Empty heap.\n" ;
-  } else {
-    dump(m_heap);
-  }
-  cout << endl;
+template <class Record>
+prifn_t PQueueOf<Record>::getPriorityFn() const {
+    return m_priorFunc;
 }
-void PQueue::dump(Node *pos) const {
-  if ( pos != nullptr ) {
-    cout << "(";
-    dump(pos->m_left);
-    if (m_structure == SKEW)
-        cout << m_priorFunc(pos->m_patient) << ":" << pos->m_patient.getPatient();
-    else
-        cout << m_priorFunc(pos->m_patient) << ":" << pos->m_patient.getPatient() << ":" << pos->m_npl;
-    dump(pos->m_right);
-    cout << ")";
-  }
+
+template <class Record>
+Patient PQueueOf<Record>::getNextPatient() {
+    PQUEUE_TIME(m_getNextNanos);
+    if (m_size == 0) {
+        throw out_of_range("The heap is empty");
+    }
+
+    if (m_structure == DARY) {
+        return removeEntryRoot();
+    }
+
+    // moves the patient out of the original root, which is deleted next
+    Patient temp = asPatient(std::move(m_heap->m_patient));
+
+    // removes root node, and the cancelled nodes that come up after it
+    m_heap = removeRoot(m_heap);
+    m_size--;
+    purgeTop();
+
+    return temp;
 }
 
-ostream& operator<<(ostream& sout, const Patient& patient) {
-  sout  << patient.getPatient() 
-        << ", temperature: " << patient.getTemperature()
-        << ", oxygen: " << patient.getOxygen()
-        << ", respiratory: " << patient.getRR()
-        << ", blood pressure: " << patient.getBP()
-        << ", nurse opinion: " << patient.getOpinion();
-  return sout;
+template <class Record>
+const Record& PQueueOf<Record>::peekNextPatient() const {
+    if (m_size == 0) {
+        throw out_of_range("The heap is empty");
+    }
+
+    if (m_structure == DARY) {
+        return m_patients[m_entries[0].m_slot];
+    }
+    return m_heap->m_patient;
 }
-ostream& operator<<(ostream& sout, const Node& node) {
-  sout << node.getPatient();
-  return sout;
+
+template <class Record>
+typename PQueueOf<Record>::const_iterator PQueueOf<Record>::begin() const {
+    return const_iterator(this);
 }
 
-// from here down are functions to help with testing
+template <class Record>
+typename PQueueOf<Record>::const_iterator PQueueOf<Record>::end() const {
+    return const_iterator();
+}
 
-bool PQueue::heapPropertyMinTest() {
-    return heapPropertyMin(m_heap);
+// starts at the root, the frontier is empty until the first increment
+template <class Record>
+PQueueOf<Record>::const_iterator::const_iterator(const PQueueOf* queue) : m_queue(nullptr) {
+    if (queue->m_size == 0) {
+        return;
+    }
+
+    m_queue = queue;
+    if (queue->m_structure == DARY) {
+        m_current.m_key = queue->m_entries[0].m_key;
+        m_current.m_node = nullptr;
+        m_current.m_index = 0;
+    }
+    else {
+        m_current.m_key = queue->m_heap->m_key;
+        m_current.m_node = queue->m_heap;
+        m_current.m_index = 0;
+    }
 }
 
-bool PQueue::heapPropertyMin(Node* ptr) {
-    if (ptr == nullptr) {
-        return true;
+template <class Record>
+const Record& PQueueOf<Record>::const_iterator::operator*() const {
+    if (m_current.m_node) {
+        return m_current.m_node->m_patient;
     }
+    return m_queue->m_patients[m_queue->m_entries[m_current.m_index].m_slot];
+}
 
-    if (ptr->m_left && m_priorFunc(ptr->m_patient) > m_priorFunc(ptr->m_left->m_patient)) {
-        return false;
+// The children of the current patient become candidates, then the best
+// candidate becomes the current patient.  The children of a pairing heap
+// node are its whole sibling list, those of a d-ary heap entry are the
+// next m_arity entries.  Cancelled nodes are passed over, but their
+// children are still candidates.
+template <class Record>
+typename PQueueOf<Record>::const_iterator& PQueueOf<Record>::const_iterator::operator++() {
+    if (m_queue == nullptr) {
+        return *this;
     }
-    if (ptr->m_right && m_priorFunc(ptr->m_patient) > m_priorFunc(ptr->m_right->m_patient)) {
-        return false;
+
+    do {
+        const Node* node = m_current.m_node;
+        if (m_queue->m_structure == DARY) {
+            int first = m_current.m_index * m_queue->m_arity + 1;
+            for (int child = first; child < first + m_queue->m_arity &&
+                 child < m_queue->m_size; child++) {
+                push(child);
+            }
+        }
+        else if (m_queue->m_structure == PAIRING) {
+            for (const Node* child = node->m_left; child; child = child->m_right) {
+                push(child);
+            }
+        }
+        else {
+            if (node->m_left) push(node->m_left);
+            if (node->m_right) push(node->m_right);
+        }
+
+        if (m_frontier.empty()) {
+            m_queue = nullptr;
+            return *this;
+        }
+        Lower lower = {m_queue};
+        pop_heap(m_frontier.begin(), m_frontier.end(), lower);
+        m_current = m_frontier.back();
+        m_frontier.pop_back();
+    } while (m_current.m_node && m_current.m_node->m_dead);
+    return *this;
+}
+
+template <class Record>
+typename PQueueOf<Record>::const_iterator PQueueOf<Record>::const_iterator::operator++(int) {
+    const_iterator temp = *this;
+    ++*this;
+    return temp;
+}
+
+// iterators are equal if both are at the end, or at the same patient
+template <class Record>
+bool PQueueOf<Record>::const_iterator::operator==(const const_iterator& rhs) const {
+    if (m_queue == nullptr || rhs.m_queue == nullptr) {
+        return m_queue == rhs.m_queue;
     }
+    return m_current.m_node == rhs.m_current.m_node &&
+           m_current.m_index == rhs.m_current.m_index;
+}
 
-    return heapPropertyMin(ptr->m_left) && heapPropertyMin(ptr->m_right);
+template <class Record>
+void PQueueOf<Record>::const_iterator::push(const Node* node) {
+    Item item = {node->m_key, node, 0};
+    m_frontier.push_back(item);
+    Lower lower = {m_queue};
+    push_heap(m_frontier.begin(), m_frontier.end(), lower);
 }
 
-bool PQueue::heapPropertyMaxTest() {
-    return heapPropertyMax(m_heap);
+template <class Record>
+void PQueueOf<Record>::const_iterator::push(int index) {
+    Item item = {m_queue->m_entries[index].m_key, nullptr, index};
+    m_frontier.push_back(item);
+    Lower lower = {m_queue};
+    push_heap(m_frontier.begin(), m_frontier.end(), lower);
 }
 
-bool PQueue::heapPropertyMax(Node* ptr) {
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::removeRoot(Node* ptr) {
     if (ptr == nullptr) {
-        return true;
+        return nullptr;
     }
 
-    if (ptr->m_left && m_priorFunc(ptr->m_patient) < m_priorFunc(ptr->m_left->m_patient)) {
-        return false;
+    // creates the new root by merging the children, which in a pairing
+    // heap are the sibling list starting at m_left
+    Node* newRoot;
+    if (m_structure == PAIRING) {
+        newRoot = combineSiblings(ptr->m_left);
     }
-    if (ptr->m_right && m_priorFunc(ptr->m_patient) < m_priorFunc(ptr->m_right->m_patient)) {
-        return false;
+    else {
+        newRoot = mergeNodes(ptr->m_left, ptr->m_right);
     }
+    m_heap = newRoot;
 
-    return heapPropertyMax(ptr->m_left) && heapPropertyMax(ptr->m_right);
+    // gives the original root back to the pool
+    m_pool.release(ptr);
+
+    return newRoot;
 }
 
-bool PQueue::leftistProperty(Node* ptr) {
-    if (ptr == nullptr) {
-        return true;
+template <class Record>
+void PQueueOf<Record>::setPriorityFn(prifn_t priFn, HEAPTYPE heapType) {
+    bool rescore = m_hasPolicy || m_priorFunc != priFn;
+    m_hasPolicy = false;
+    if (m_heapType == heapType && !rescore) return;
+
+    if (m_structure == DARY) {
+        if (rescore) {
+            for (int i = 0; i < m_size; i++) {
+                m_entries[i].m_key = priFn(asPatient(m_patients[m_entries[i].m_slot]));
+            }
+            PQUEUE_COUNT(m_priorityCalls, m_size);
+        }
+        m_priorFunc = priFn;
+        m_heapType = heapType;
+        buildArrayHeap();
+        return;
     }
 
-    if (NPL(ptr->m_left) < NPL(ptr->m_right)) {
-        return false;
+    // takes the nodes out of the heap and builds it again with the new
+    // heaptype, keys only change if the priority function does
+    vector<Node*> nodes;
+    collectLive(nodes);
+    if (rescore) {
+        for (int i = 0; i < (int)nodes.size(); i++) {
+            nodes[i]->m_key = priFn(asPatient(nodes[i]->m_patient));
+        }
+        PQUEUE_COUNT(m_priorityCalls, nodes.size());
     }
 
-    return leftistProperty(ptr->m_left) && leftistProperty(ptr->m_right);
+    m_priorFunc = priFn;
+    m_heapType = heapType;
+    m_heap = heapify(nodes);
 }
 
-bool PQueue::testNPL(Node* ptr) {
-    if (ptr == nullptr) {
-        return true;
+// the keys only change if the policy does, and then they are all scored
+// in batches
+template <class Record>
+void PQueueOf<Record>::setPriorityPolicy(const PriorityPolicy& policy, HEAPTYPE heapType) {
+    bool rescore = !m_hasPolicy || m_policy != policy;
+    m_policy = policy;
+    m_hasPolicy = true;
+    m_priorFunc = nullptr;
+    if (m_heapType == heapType && !rescore) return;
+
+    m_heapType = heapType;
+    if (m_structure == DARY) {
+        if (rescore) {
+            scoreEntries(0);
+        }
+        buildArrayHeap();
+        return;
     }
 
-    int leftNPL = NPL(ptr->m_left);
-    int rightNPL = NPL(ptr->m_right);
+    vector<Node*> nodes;
+    collectLive(nodes);
+    if (rescore) {
+        scoreNodes(nodes);
+    }
+    m_heap = heapify(nodes);
+}
 
-    if (ptr->m_npl != min(leftNPL, rightNPL) + 1) {
+template <class Record>
+bool PQueueOf<Record>::hasPriorityPolicy() const {
+    return m_hasPolicy;
+}
+
+template <class Record>
+const PriorityPolicy& PQueueOf<Record>::getPriorityPolicy() const {
+    if (!m_hasPolicy) {
+        throw domain_error("The queue has no priority policy");
+    }
+    return m_policy;
+}
+
+// Queues score alike if they have the same priority function, or equal
+// policies even if they were built apart
+template <class Record>
+bool PQueueOf<Record>::samePriority(const PQueueOf& rhs) const {
+    if (m_hasPolicy != rhs.m_hasPolicy) {
         return false;
     }
+    return m_hasPolicy ? (m_policy == rhs.m_policy) : (m_priorFunc == rhs.m_priorFunc);
+}
 
-    return testNPL(ptr->m_left) && testNPL(ptr->m_right);
-}
\ No newline at end of file
+// Sets the key of every node in nodes with m_policy.  The nodes go in
+// chunks small enough that the columns, the keys and the nodes are still
+// in the cache when the keys are written back.  Building with PQUEUE_DEBUG
+// defined checks the keys against the scalar m_policy.score.
+template <class Record>
+void PQueueOf<Record>::scoreNodes(vector<Node*>& nodes) {
+    VitalsColumns vitals;
+    int keys[SCORECHUNK];
+    int count = (int)nodes.size();
+    PQUEUE_COUNT(m_priorityCalls, count);
+    for (int start = 0; start < count; start += SCORECHUNK) {
+        int end = (start + SCORECHUNK < count) ? start + SCORECHUNK : count;
+        vitals.resize(end - start);
+        for (int i = start; i < end; i++) {
+            vitals.set(i - start, nodes[i]->m_patient);
+        }
+        scoreBatch(m_policy, vitals, keys);
+        for (int i = start; i < end; i++) {
+            nodes[i]->m_key = keys[i - start];
+#ifdef PQUEUE_DEBUG
+            assert(nodes[i]->m_key == m_policy.score(nodes[i]->m_patient));
+#endif
+        }
+    }
+}
+
+// same as scoreNodes, for the entries from first to the end of the array
+template <class Record>
+void PQueueOf<Record>::scoreEntries(int first) {
+    VitalsColumns vitals;
+    int keys[SCORECHUNK];
+    PQUEUE_COUNT(m_priorityCalls, m_size - first);
+    for (int start = first; start < m_size; start += SCORECHUNK) {
+        int end = (start + SCORECHUNK < m_size) ? start + SCORECHUNK : m_size;
+        vitals.resize(end - start);
+        for (int i = start; i < end; i++) {
+            vitals.set(i - start, m_patients[m_entries[i].m_slot]);
+        }
+        scoreBatch(m_policy, vitals, keys);
+        for (int i = start; i < end; i++) {
+            m_entries[i].m_key = keys[i - start];
+#ifdef PQUEUE_DEBUG
+            assert(m_entries[i].m_key == m_policy.score(m_patients[m_entries[i].m_slot]));
+#endif
+        }
+    }
+}
+
+// Sets keys to the scores of records, the way scoreNodes does for nodes
+template <class Record>
+void PQueueOf<Record>::scoreRecords(const vector<Record>& records, vector<int>& keys) {
+    VitalsColumns vitals;
+    int count = (int)records.size();
+    keys.resize(count);
+    PQUEUE_COUNT(m_priorityCalls, count);
+    for (int start = 0; start < count; start += SCORECHUNK) {
+        int end = (start + SCORECHUNK < count) ? start + SCORECHUNK : count;
+        vitals.resize(end - start);
+        for (int i = start; i < end; i++) {
+            vitals.set(i - start, records[i]);
+        }
+        scoreBatch(m_policy, vitals, keys.data() + start);
+#ifdef PQUEUE_DEBUG
+        for (int i = start; i < end; i++) {
+            assert(keys[i] == m_policy.score(records[i]));
+        }
+#endif
+    }
+}
+
+// Builds a heap out of nodes in O(n).  Every node starts as a one node heap
+// and the heaps are merged in pairs, round after round, until one is left.
+// Merging two heaps of size k costs O(log k), which sums to O(n) over all
+// the rounds.
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::heapify(vector<Node*>& nodes) {
+    int count = (int)nodes.size();
+    for (int i = 0; i < count; i++) {
+        nodes[i]->m_left = nullptr;
+        nodes[i]->m_right = nullptr;
+        nodes[i]->m_parent = nullptr;
+        nodes[i]->m_npl = 0;
+    }
+    return meldAll(nodes);
+}
+
+// merges the heaps rooted at roots in pairs, round after round, and
+// returns the root of the one heap left
+template <class Record>
+NodeOf<Record>* PQueueOf<Record>::meldAll(vector<Node*>& roots) {
+    int count = (int)roots.size();
+    while (count > 1) {
+        int merged = 0;
+        for (int i = 0; i + 1 < count; i += 2) {
+            roots[merged++] = mergeNodes(roots[i], roots[i + 1]);
+        }
+        if (count % 2 == 1) {
+            roots[merged++] = roots[count - 1];
+        }
+        count = merged;
+    }
+
+    if (count == 0) {
+        return nullptr;
+    }
+    roots[0]->m_parent = nullptr;
+    return roots[0];
+}
+
+// Takes the k highest priority live nodes out of a skew or leftist heap at
+// once, along with the cancelled nodes found on the way.  The nodes are
+// found in priority order through a frontier heap holding the children of
+// the nodes taken so far, and when k live nodes are taken the subtrees
+// left in the frontier are melded into the new heap.  That is one meld of
+// at most k + 1 heaps instead of k removeRoot merges.  The taken nodes are
+// still allocated, the caller moves the patients out and releases them.
+template <class Record>
+void PQueueOf<Record>::takeTopNodes(int k, vector<Node*>& taken) {
+    auto lower = [this](Node* a, Node* b) {return higherKey(b->m_key, a->m_key);};
+    vector<Node*> frontier;
+    frontier.push_back(m_heap);
+    int live = 0;
+    while (live < k) {
+        pop_heap(frontier.begin(), frontier.end(), lower);
+        Node* node = frontier.back();
+        frontier.pop_back();
+        taken.push_back(node);
+        if (node->m_dead) {
+            m_cancelled--;
+        }
+        else {
+            live++;
+        }
+        if (node->m_left) {
+            frontier.push_back(node->m_left);
+            push_heap(frontier.begin(), frontier.end(), lower);
+        }
+        if (node->m_right) {
+            frontier.push_back(node->m_right);
+            push_heap(frontier.begin(), frontier.end(), lower);
+        }
+    }
+
+    m_heap = meldAll(frontier);
+    m_size -= (int)taken.size();
+    purgeTop();
+}
+
+template <class Record>
+void PQueueOf<Record>::setStructure(STRUCTURE structure){
+    if (m_structure == structure) return;
+
+    if (m_structure == DARY) {
+        // every patient moves from its slot into a node with the same key
+        vector<Node*> nodes;
+        nodes.reserve(m_size);
+        for (int i = 0; i < m_size; i++) {
+            nodes.push_back(m_pool.allocate(std::move(m_patients[m_entries[i].m_slot]),
+                                            m_entries[i].m_key));
+        }
+        PQUEUE_COUNT(m_nodeAllocations, m_size);
+        clearArray();
+        m_structure = structure;
+        m_heap = heapify(nodes);
+        return;
+    }
+
+    if (structure == DARY) {
+        // every patient moves out of its node into a slot with the same key
+        vector<Node*> nodes;
+        collectLive(nodes);
+        m_entries.reserve(nodes.size());
+        m_patients.reserve(nodes.size());
+        for (int i = 0; i < (int)nodes.size(); i++) {
+            HeapEntry entry = {nodes[i]->m_key, i};
+            m_patients.push_back(std::move(nodes[i]->m_patient));
+            m_entries.push_back(entry);
+        }
+        m_pool.releaseAll();
+        m_heap = nullptr;
+        m_structure = structure;
+        buildArrayHeap();
+        return;
+    }
+
+    // takes the nodes out of the heap and builds it again with the new
+    // structure, the keys stay the same
+    vector<Node*> nodes;
+    collectLive(nodes);
+    m_structure = structure;
+    m_heap = heapify(nodes);
+}
+
+template <class Record>
+STRUCTURE PQueueOf<Record>::getStructure() const {
+    return m_structure;
+}
+
+template <class Record>
+int PQueueOf<Record>::getArity() const {
+    return m_arity;
+}
+
+template <class Record>
+void PQueueOf<Record>::setArity(int arity) {
+    if (arity < 2) {
+        throw out_of_range("A d-ary heap needs at least 2 children per node");
+    }
+    if (m_arity == arity) return;
+
+    m_arity = arity;
+    if (m_structure == DARY) {
+        buildArrayHeap();
+    }
+}
+
+// returns true if key1 has a strictly higher priority than key2
+template <class Record>
+bool PQueueOf<Record>::higherKey(int key1, int key2) const {
+    PQUEUE_COUNT(m_comparisons, 1);
+    if (m_heapType == MINHEAP) {
+        return key1 < key2;
+    }
+    return key1 > key2;
+}
+
+// puts the patient in a free slot and sifts its entry up from the bottom,
+// returns the slot
+template <class Record>
+int PQueueOf<Record>::insertEntry(Record&& patient, int key) {
+    int slot = appendEntry(std::move(patient), key);
+    siftUp(m_size - 1);
+    return slot;
+}
+
+// puts the patient in a free slot and its entry at the end of the array,
+// without restoring the heap property.  Returns the slot.
+template <class Record>
+int PQueueOf<Record>::appendEntry(Record&& patient, int key) {
+    HeapEntry entry = {key, 0};
+    if (!m_freeSlots.empty()) {
+        entry.m_slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        m_patients[entry.m_slot] = std::move(patient);
+    }
+    else {
+        entry.m_slot = (int)m_patients.size();
+        m_patients.push_back(std::move(patient));
+        m_positions.push_back(-1);
+    }
+
+    m_positions[entry.m_slot] = m_size;
+    m_entries.push_back(entry);
+    m_size++;
+    return entry.m_slot;
+}
+
+// The arrays grow by at least double, so inserting batch after batch
+// still copies each entry O(1) times on average
+template <class Record>
+void PQueueOf<Record>::reserveEntries(int count) {
+    size_t entries = m_entries.size() + count;
+    if (m_entries.capacity() < entries) {
+        m_entries.reserve(max(entries, 2 * m_entries.capacity()));
+    }
+    size_t slots = m_patients.size() + max(0, count - (int)m_freeSlots.size());
+    if (m_patients.capacity() < slots) {
+        m_patients.reserve(max(slots, 2 * m_patients.capacity()));
+    }
+    if (m_positions.capacity() < slots) {
+        m_positions.reserve(max(slots, 2 * m_positions.capacity()));
+    }
+}
+
+// Restores the heap after added entries were appended at the end.  A few
+// entries are sifted up one by one, otherwise the whole array is rebuilt
+// in O(n).
+template <class Record>
+void PQueueOf<Record>::siftAppended(int added) {
+    if (added * 8 >= m_size - added) {
+        buildArrayHeap();
+        return;
+    }
+    for (int i = m_size - added; i < m_size; i++) {
+        siftUp(i);
+    }
+}
+
+// moves the root patient out, the last entry takes its place and sifts down
+template <class Record>
+Patient PQueueOf<Record>::removeEntryRoot() {
+    return removeEntry(0);
+}
+
+// Moves the patient of the entry at index out.  The last entry takes its
+// place and sifts up or down, since away from the root it may have a
+// higher priority than the new parent.
+template <class Record>
+Patient PQueueOf<Record>::removeEntry(int index) {
+    int slot = m_entries[index].m_slot;
+    Patient temp = asPatient(std::move(m_patients[slot]));
+    m_freeSlots.push_back(slot);
+    m_positions[slot] = -1;
+
+    HeapEntry last = m_entries.back();
+    m_entries.pop_back();
+    m_size--;
+
+    if (m_size == 0) {
+        clearArray();
+    }
+    else if (index < m_size) {
+        m_entries[index] = last;
+        m_positions[last.m_slot] = index;
+        if (index > 0 && higherKey(last.m_key, m_entries[(index - 1) / m_arity].m_key)) {
+            siftUp(index);
+        }
+        else {
+            siftDown(index);
+        }
+    }
+
+    return temp;
+}
+
+// gives the entry at index a new key and sifts it up if it got a higher
+// priority, down otherwise
+template <class Record>
+void PQueueOf<Record>::moveEntry(int index, int key) {
+    int oldKey = m_entries[index].m_key;
+    m_entries[index].m_key = key;
+    if (higherKey(key, oldKey)) {
+        siftUp(index);
+    }
+    else {
+        siftDown(index);
+    }
+}
+
+// moves parents down into the hole until the entry finds its place
+template <class Record>
+void PQueueOf<Record>::siftUp(int index) {
+    HeapEntry entry = m_entries[index];
+    while (index > 0) {
+        int parent = (index - 1) / m_arity;
+        if (!higherKey(entry.m_key, m_entries[parent].m_key)) {
+            break;
+        }
+        m_entries[index] = m_entries[parent];
+        m_positions[m_entries[index].m_slot] = index;
+        index = parent;
+    }
+    m_entries[index] = entry;
+    m_positions[entry.m_slot] = index;
+}
+
+// moves the highest priority child up into the hole until the entry
+// finds its place, the children of a node sit next to each other
+template <class Record>
+void PQueueOf<Record>::siftDown(int index) {
+    HeapEntry entry = m_entries[index];
+    while (true) {
+        int first = index * m_arity + 1;
+        if (first >= m_size) {
+            break;
+        }
+
+        int last = first + m_arity;
+        if (last > m_size) {
+            last = m_size;
+        }
+        int best = first;
+        for (int child = first + 1; child < last; child++) {
+            if (higherKey(m_entries[child].m_key, m_entries[best].m_key)) {
+                best = child;
+            }
+        }
+
+        if (!higherKey(m_entries[best].m_key, entry.m_key)) {
+            break;
+        }
+        m_entries[index] = m_entries[best];
+        m_positions[m_entries[index].m_slot] = index;
+        index = best;
+    }
+    m_entries[index] = entry;
+    m_positions[entry.m_slot] = index;
+}
+
+// bottom-up heap construction, O(n).  The positions are set for every
+// entry first, the sifts keep them up to date after that.
+template <class Record>
+void PQueueOf<Record>::buildArrayHeap() {
+    m_positions.assign(m_patients.size(), -1);
+    for (int i = 0; i < m_size; i++) {
+        m_positions[m_entries[i].m_slot] = i;
+    }
+    for (int i = (m_size - 2) / m_arity; i >= 0 && m_size > 1; i--) {
+        siftDown(i);
+    }
+}
+
+// copies only the queued patients, so the copy has no free slots
+template <class Record>
+void PQueueOf<Record>::copyArray(const PQueueOf& rhs) {
+    m_entries.reserve(rhs.m_entries.size());
+    m_patients.reserve(rhs.m_entries.size());
+    for (int i = 0; i < (int)rhs.m_entries.size(); i++) {
+        HeapEntry entry = {rhs.m_entries[i].m_key, i};
+        m_patients.push_back(rhs.m_patients[rhs.m_entries[i].m_slot]);
+        m_entries.push_back(entry);
+        m_positions.push_back(i);
+    }
+}
+
+template <class Record>
+void PQueueOf<Record>::clearArray() {
+    m_entries.clear();
+    m_patients.clear();
+    m_freeSlots.clear();
+    m_positions.clear();
+}
+
+template <class Record>
+HEAPTYPE PQueueOf<Record>::getHeapType() const {
+    return m_heapType;
+}
+
+template <class Record>
+void PQueueOf<Record>::printPatientQueue() const {
+    if (m_structure == DARY) {
+        preOrderArray();
+        return;
+    }
+    preOrder(m_heap);
+}
+
+// preorder over the implicit d-ary tree, children in order from the left
+template <class Record>
+void PQueueOf<Record>::preOrderArray() const {
+    vector<int> stack;
+    if (m_size > 0) {
+        stack.push_back(0);
+    }
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        cout << "[" << m_entries[index].m_key << "] "
+             << m_patients[m_entries[index].m_slot] << endl;
+        for (int child = index * m_arity + m_arity; child > index * m_arity; child--) {
+            if (child < m_size) {
+                stack.push_back(child);
+            }
+        }
+    }
+}
+
+template <class Record>
+void PQueueOf<Record>::preOrder(Node* node) const {
+    if (node != nullptr) {
+        if (!node->m_dead) {
+            cout << "[" << node->m_key << "] " << node->m_patient << endl;
+        }
+        preOrder(node->m_left);
+        preOrder(node->m_right);
+    }
+}
+
+template <class Record>
+PQueueStats PQueueOf<Record>::getStats() const {
+#ifdef PQUEUE_STATS
+    return m_stats;
+#else
+    return PQueueStats();
+#endif
+}
+
+template <class Record>
+void PQueueOf<Record>::resetStats() {
+#ifdef PQUEUE_STATS
+    m_stats = PQueueStats();
+#endif
+}
+
+template <class Record>
+HeapReport PQueueOf<Record>::getHeapReport() const {
+    HeapReport report;
+    report.m_nodes = m_size;
+    if (m_size == 0) {
+        return report;
+    }
+
+    long long depthSum = 0;
+    if (m_structure == DARY) {
+        reportArray(report, depthSum);
+    }
+    else if (m_structure == PAIRING) {
+        reportPairing(report, depthSum);
+    }
+    else {
+        reportTree(report, depthSum);
+    }
+    report.m_averageDepth = (double)depthSum / m_size;
+    report.m_depthRatio = report.m_maxDepth / log2((double)m_size + 1);
+    return report;
+}
+
+// the array is a complete tree, so only the level sizes are needed
+template <class Record>
+void PQueueOf<Record>::reportArray(HeapReport& report, long long& depthSum) const {
+    long long levelSize = 1;
+    int placed = 0;
+    for (int depth = 0; placed < m_size; depth++) {
+        int count = (int)(levelSize < m_size - placed ? levelSize : m_size - placed);
+        depthSum += (long long)depth * count;
+        placed += count;
+        report.m_maxDepth = depth;
+        levelSize *= m_arity;
+    }
+    for (long long index = 0; index < m_size; index = index * m_arity + m_arity) {
+        report.m_rightSpine++;
+    }
+}
+
+// m_left leads one level down to the first child and m_right to the next
+// sibling on the same level
+template <class Record>
+void PQueueOf<Record>::reportPairing(HeapReport& report, long long& depthSum) const {
+    for (Node* child = m_heap->m_left; child; child = child->m_right) {
+        report.m_rightSpine++;
+    }
+    vector<pair<const Node*, int> > stack;
+    stack.push_back(make_pair(m_heap, 0));
+    while (!stack.empty()) {
+        const Node* node = stack.back().first;
+        int depth = stack.back().second;
+        stack.pop_back();
+        depthSum += depth;
+        if (depth > report.m_maxDepth) {
+            report.m_maxDepth = depth;
+        }
+        if (node->m_left) stack.push_back(make_pair(node->m_left, depth + 1));
+        if (node->m_right) stack.push_back(make_pair(node->m_right, depth));
+    }
+}
+
+// A post-order walk, so the size and NPL of both subtrees are known when
+// a node is finished.  done holds the size and NPL of the finished
+// subtrees whose parent is not finished yet.
+template <class Record>
+void PQueueOf<Record>::reportTree(HeapReport& report, long long& depthSum) const {
+    for (Node* node = m_heap; node; node = node->m_right) {
+        report.m_rightSpine++;
+    }
+
+    struct Frame {
+        const Node* m_node;
+        int m_depth;
+        bool m_expanded; // its children are on the stack or finished
+    };
+    vector<Frame> stack;
+    vector<pair<int, int> > done;
+    int heavy = 0;
+    Frame root = {m_heap, 0, false};
+    stack.push_back(root);
+    while (!stack.empty()) {
+        Frame& frame = stack.back();
+        const Node* node = frame.m_node;
+        if (!frame.m_expanded) {
+            frame.m_expanded = true;
+            int depth = frame.m_depth;
+            depthSum += depth;
+            if (depth > report.m_maxDepth) {
+                report.m_maxDepth = depth;
+            }
+            // frame is not used after this, push_back can move it
+            if (node->m_right) {
+                Frame right = {node->m_right, depth + 1, false};
+                stack.push_back(right);
+            }
+            if (node->m_left) {
+                Frame left = {node->m_left, depth + 1, false};
+                stack.push_back(left);
+            }
+            continue;
+        }
+        stack.pop_back();
+
+        // the left child went on the stack last, so it finished first
+        pair<int, int> right(0, -1);
+        pair<int, int> left(0, -1);
+        if (node->m_right) {
+            right = done.back();
+            done.pop_back();
+        }
+        if (node->m_left) {
+            left = done.back();
+            done.pop_back();
+        }
+        if (right.first > left.first) {
+            heavy++;
+        }
+        int npl = std::min(left.second, right.second) + 1;
+        if (npl >= (int)report.m_nplCounts.size()) {
+            report.m_nplCounts.resize(npl + 1, 0);
+        }
+        report.m_nplCounts[npl]++;
+        done.push_back(make_pair(left.first + right.first + 1, npl));
+    }
+    report.m_imbalance = (double)heavy / m_size;
+}
+
+template <class Record>
+void PQueueOf<Record>::dump() const {
+  if (m_size == 0) {
+    cout << "Empty heap.\n" ;
+  } else if (m_structure == DARY) {
+    dumpArray(0);
+  } else {
+    dump(m_heap);
+  }
+  cout << endl;
+}
+// prints a node of the d-ary heap followed by its children
+template <class Record>
+void PQueueOf<Record>::dumpArray(int index) const {
+  if ( index < m_size ) {
+    cout << "(";
+    cout << m_entries[index].m_key << ":" << m_patients[m_entries[index].m_slot].getPatient();
+    for (int child = index * m_arity + 1; child <= index * m_arity + m_arity; child++)
+        dumpArray(child);
+    cout << ")";
+  }
+}
+template <class Record>
+void PQueueOf<Record>::dump(Node *pos) const {
+  if ( pos != nullptr ) {
+    cout << "(";
+    dump(pos->m_left);
+    if (pos->m_dead)
+        cout << "x"; // cancelled
+    if (m_structure != LEFTIST)
+        cout << pos->m_key << ":" << pos->m_patient.getPatient();
+    else
+        cout << pos->m_key << ":" << pos->m_patient.getPatient() << ":" << pos->m_npl;
+    dump(pos->m_right);
+    cout << ")";
+  }
+}
+
+template <class Record>
+NodePoolOf<Record>::NodePoolOf() {
+    m_open = nullptr;
+    m_capacity = 0;
+    m_highWater = 0;
+    m_nextSlabSize = MINSLAB;
+    m_live = 0;
+    m_slabAllocations = 0;
+    m_nodeAllocations = 0;
+}
+
+template <class Record>
+NodePoolOf<Record>::~NodePoolOf() {
+    releaseAll();
+}
+
+// allocates a new slab and puts all of its slots on its free list
+template <class Record>
+void NodePoolOf<Record>::addSlab() {
+    int size = m_nextSlabSize;
+    Slot* slots = new Slot[size];
+    Slab* slab = nullptr;
+    try {
+        slab = new Slab;
+        m_slabs.push_back(slab);
+    }
+    catch (...) {
+        delete slab;
+        delete[] slots;
+        throw;
+    }
+    m_slabAllocations++;
+    if (m_nextSlabSize < MAXSLAB) {
+        m_nextSlabSize *= 2;
+    }
+
+    for (int i = 0; i < size; i++) {
+        slots[i].m_live = false;
+        slots[i].m_next = (i + 1 < size) ? &slots[i + 1] : nullptr;
+    }
+    slab->m_slots = slots;
+    slab->m_size = size;
+    slab->m_live = 0;
+    slab->m_index = (int)m_slabs.size() - 1;
+    slab->m_free = slots;
+    openSlab(slab);
+    m_capacity += size;
+}
+
+template <class Record>
+typename NodePoolOf<Record>::Slot* NodePoolOf<Record>::takeSlot() {
+    if (m_open == nullptr) {
+        addSlab();
+    }
+
+    Slab* slab = m_open;
+    Slot* slot = slab->m_free;
+    slab->m_free = slot->m_next;
+    if (slab->m_free == nullptr) {
+        closeSlab(slab);
+    }
+    slot->m_slab = slab;
+    slab->m_live++;
+    m_live++;
+    if (m_live > m_highWater) {
+        m_highWater = m_live;
+    }
+    m_nodeAllocations++;
+    return slot;
+}
+
+template <class Record>
+void NodePoolOf<Record>::release(Node* node) {
+    // the node is stored at the start of its slot
+    node->~Node();
+    returnSlot(reinterpret_cast<Slot*>(node));
+}
+
+template <class Record>
+void NodePoolOf<Record>::returnSlot(Slot* slot) {
+    Slab* slab = slot->m_slab;
+    slot->m_live = false;
+    if (slab->m_free == nullptr) {
+        openSlab(slab);
+    }
+    slot->m_next = slab->m_free;
+    slab->m_free = slot;
+    slab->m_live--;
+    m_live--;
+    if (slab->m_live == 0 && spareSlab(slab)) {
+        freeSlab(slab);
+    }
+}
+
+// An empty slab is kept while the pool needs it to hold as many nodes as
+// it ever has, so a queue that drains and fills up again does not go back
+// to new[] every time
+template <class Record>
+bool NodePoolOf<Record>::spareSlab(const Slab* slab) const {
+    return m_capacity - slab->m_size >= m_highWater;
+}
+
+template <class Record>
+void NodePoolOf<Record>::openSlab(Slab* slab) {
+    slab->m_prevOpen = nullptr;
+    slab->m_nextOpen = m_open;
+    if (m_open) {
+        m_open->m_prevOpen = slab;
+    }
+    m_open = slab;
+}
+
+template <class Record>
+void NodePoolOf<Record>::closeSlab(Slab* slab) {
+    if (slab->m_prevOpen) {
+        slab->m_prevOpen->m_nextOpen = slab->m_nextOpen;
+    }
+    else {
+        m_open = slab->m_nextOpen;
+    }
+    if (slab->m_nextOpen) {
+        slab->m_nextOpen->m_prevOpen = slab->m_prevOpen;
+    }
+}
+
+// the last slab takes the place of slab in m_slabs
+template <class Record>
+void NodePoolOf<Record>::freeSlab(Slab* slab) {
+    closeSlab(slab);
+    Slab* last = m_slabs.back();
+    m_slabs[slab->m_index] = last;
+    last->m_index = slab->m_index;
+    m_slabs.pop_back();
+    m_capacity -= slab->m_size;
+    delete[] slab->m_slots;
+    delete slab;
+}
+
+// Adds every live node to nodes.  The pool only holds the nodes of one
+// heap, so this finds the whole heap while reading the slabs in memory
+// order instead of chasing child pointers.
+template <class Record>
+void NodePoolOf<Record>::collect(vector<Node*>& nodes) const {
+    nodes.reserve(nodes.size() + m_live);
+    for (int i = 0; i < (int)m_slabs.size(); i++) {
+        const Slab* slab = m_slabs[i];
+        for (int j = 0; j < slab->m_size && slab->m_live > 0; j++) {
+            if (slab->m_slots[j].m_live) {
+                nodes.push_back(reinterpret_cast<Node*>(slab->m_slots[j].m_storage));
+            }
+        }
+    }
+}
+
+// goes through the slabs in memory order instead of following the tree
+template <class Record>
+void NodePoolOf<Record>::releaseAll() {
+    for (int i = 0; i < (int)m_slabs.size(); i++) {
+        Slab* slab = m_slabs[i];
+        for (int j = 0; j < slab->m_size && slab->m_live > 0; j++) {
+            if (slab->m_slots[j].m_live) {
+                reinterpret_cast<Node*>(slab->m_slots[j].m_storage)->~Node();
+            }
+        }
+        delete[] slab->m_slots;
+        delete slab;
+    }
+    m_slabs.clear();
+    m_open = nullptr;
+    m_capacity = 0;
+    m_highWater = 0;
+    m_nextSlabSize = MINSLAB;
+    m_live = 0;
+}
+
+// The slabs of rhs move over as they are, so nodes keep their addresses.
+// Slabs of rhs that are empty and not needed are freed on the way.
+template <class Record>
+void NodePoolOf<Record>::adopt(NodePoolOf& rhs) {
+    if (this == &rhs) {
+        return;
+    }
+
+    m_slabs.reserve(m_slabs.size() + rhs.m_slabs.size());
+    m_capacity += rhs.m_capacity;
+    m_live += rhs.m_live;
+    if (m_live > m_highWater) {
+        m_highWater = m_live;
+    }
+    if (rhs.m_nextSlabSize > m_nextSlabSize) {
+        m_nextSlabSize = rhs.m_nextSlabSize;
+    }
+    for (int i = 0; i < (int)rhs.m_slabs.size(); i++) {
+        Slab* slab = rhs.m_slabs[i];
+        slab->m_index = (int)m_slabs.size();
+        m_slabs.push_back(slab);
+        if (slab->m_free != nullptr) {
+            openSlab(slab);
+        }
+        if (slab->m_live == 0 && spareSlab(slab)) {
+            freeSlab(slab);
+        }
+    }
+
+    rhs.m_slabs.clear();
+    rhs.m_open = nullptr;
+    rhs.m_capacity = 0;
+    rhs.m_highWater = 0;
+    rhs.m_nextSlabSize = MINSLAB;
+    rhs.m_live = 0;
+}
+
+template <class Record>
+void NodePoolOf<Record>::swap(NodePoolOf& rhs) noexcept {
+    m_slabs.swap(rhs.m_slabs);
+    std::swap(m_open, rhs.m_open);
+    std::swap(m_capacity, rhs.m_capacity);
+    std::swap(m_highWater, rhs.m_highWater);
+    std::swap(m_nextSlabSize, rhs.m_nextSlabSize);
+    std::swap(m_live, rhs.m_live);
+    std::swap(m_slabAllocations, rhs.m_slabAllocations);
+    std::swap(m_nodeAllocations, rhs.m_nodeAllocations);
+}
+
+ostream& operator<<(ostream& sout, const Patient& patient) {
+  sout  << patient.getPatient() 
+        << ", temperature: " << patient.getTemperature()
+        << ", oxygen: " << patient.getOxygen()
+        << ", respiratory: " << patient.getRR()
+        << ", blood pressure: " << patient.getBP()
+        << ", nurse opinion: " << patient.getOpinion();
+  return sout;
+}
+
+NameTable::NameTable() {
+    intern(""); // id 0, the name of the empty patient
+}
+
+// never destroyed, so packed patients in static queues can still use it
+NameTable& NameTable::shared() {
+    static NameTable* table = new NameTable();
+    return *table;
+}
+
+uint32_t NameTable::intern(const string& name) {
+    lock_guard<mutex> guard(m_lock);
+    pair<unordered_map<string, uint32_t>::iterator, bool> result =
+        m_ids.insert(make_pair(name, (uint32_t)m_names.size()));
+    if (result.second) {
+        // the key of a map element stays where it is
+        m_names.push_back(&result.first->first);
+    }
+    return result.first->second;
+}
+
+string NameTable::getName(uint32_t id) const {
+    lock_guard<mutex> guard(m_lock);
+    if (id >= m_names.size()) {
+        throw out_of_range("No name has this id");
+    }
+    return *m_names[id];
+}
+
+bool NameTable::findId(const string& name, uint32_t& id) const {
+    lock_guard<mutex> guard(m_lock);
+    unordered_map<string, uint32_t>::const_iterator found = m_ids.find(name);
+    if (found == m_ids.end()) {
+        return false;
+    }
+    id = found->second;
+    return true;
+}
+
+int NameTable::size() const {
+    lock_guard<mutex> guard(m_lock);
+    return (int)m_names.size();
+}
+
+PackedPatient::PackedPatient() {
+    m_name = 0; m_temperature = 37; m_oxygen = 100;
+    m_RR = 20; m_BP = 100; m_opinion = 10;
+}
+
+PackedPatient::PackedPatient(const Patient& patient) {
+    int vitals[] = {patient.getTemperature(), patient.getOxygen(), patient.getRR(),
+                    patient.getBP(), patient.getOpinion()};
+    for (int i = 0; i < 5; i++) {
+        if (vitals[i] < 0 || vitals[i] > UINT8_MAX) {
+            throw out_of_range("A vital of the patient does not fit in a byte");
+        }
+    }
+    m_name = NameTable::shared().intern(patient.getPatient());
+    m_temperature = (uint8_t)vitals[0];
+    m_oxygen = (uint8_t)vitals[1];
+    m_RR = (uint8_t)vitals[2];
+    m_BP = (uint8_t)vitals[3];
+    m_opinion = (uint8_t)vitals[4];
+}
+
+// sets the members instead of calling the Patient constructor, which would
+// turn a patient with vitals out of the triage ranges into an empty one
+Patient PackedPatient::unpack() const {
+    Patient patient;
+    patient.setPatient(getPatient());
+    patient.setTemperature(m_temperature);
+    patient.setOxygen(m_oxygen);
+    patient.setRR(m_RR);
+    patient.setBP(m_BP);
+    patient.setOpinion(m_opinion);
+    return patient;
+}
+
+bool PackedPatient::operator==(const PackedPatient& rhs) const {
+    return ((m_name == rhs.m_name) &&
+            (m_temperature == rhs.m_temperature) &&
+            (m_oxygen == rhs.m_oxygen) &&
+            (m_RR == rhs.m_RR) &&
+            (m_BP == rhs.m_BP) &&
+            (m_opinion == rhs.m_opinion));
+}
+
+// the vitals are compared first, so the name is only looked up for a
+// patient that could match
+bool PackedPatient::operator==(const Patient& rhs) const {
+    if (m_temperature != rhs.getTemperature() || m_oxygen != rhs.getOxygen() ||
+        m_RR != rhs.getRR() || m_BP != rhs.getBP() || m_opinion != rhs.getOpinion()) {
+        return false;
+    }
+    uint32_t id;
+    return NameTable::shared().findId(rhs.getPatient(), id) && id == m_name;
+}
+
+ostream& operator<<(ostream& sout, const PackedPatient& patient) {
+  sout << patient.unpack();
+  return sout;
+}
+
+PriorityPolicy::PriorityPolicy() {
+    for (int i = 0; i < NUMVITALS; i++) {
+        m_weights[i] = 0;
+    }
+    m_constant = 0;
+    m_low = INT_MIN;
+    m_high = INT_MAX;
+}
+
+// a VITAL made from a bad int would index past m_weights
+static void checkVital(VITAL vital) {
+    if (vital < 0 || vital >= NUMVITALS) {
+        throw out_of_range("There is no such vital");
+    }
+}
+
+void PriorityPolicy::setWeight(VITAL vital, int weight) {
+    checkVital(vital);
+    m_weights[vital] = weight;
+}
+
+void PriorityPolicy::setConstant(int constant) {
+    m_constant = constant;
+}
+
+// keeps m_terms sorted and merges a term into one with the same vital and
+// threshold, so equal policies have equal m_terms
+void PriorityPolicy::addAbove(VITAL vital, int threshold, int weight) {
+    checkVital(vital);
+    vector<Term>::iterator it = m_terms.begin();
+    while (it != m_terms.end() && (it->m_vital < vital ||
+           (it->m_vital == vital && it->m_threshold < threshold))) {
+        ++it;
+    }
+    if (it != m_terms.end() && it->m_vital == vital && it->m_threshold == threshold) {
+        it->m_weight += weight;
+        if (it->m_weight == 0) {
+            m_terms.erase(it);
+        }
+    }
+    else if (weight != 0) {
+        Term term = {vital, threshold, weight};
+        m_terms.insert(it, term);
+    }
+}
+
+// w * max(0, t - v) = w * t - w * v + w * max(0, v - t)
+void PriorityPolicy::addBelow(VITAL vital, int threshold, int weight) {
+    checkVital(vital);
+    m_constant += weight * threshold;
+    m_weights[vital] -= weight;
+    addAbove(vital, threshold, weight);
+}
+
+void PriorityPolicy::setClamp(int low, int high) {
+    if (low > high) {
+        throw out_of_range("The clamp is empty");
+    }
+    m_low = low;
+    m_high = high;
+}
+
+bool PriorityPolicy::operator==(const PriorityPolicy& rhs) const {
+    for (int i = 0; i < NUMVITALS; i++) {
+        if (m_weights[i] != rhs.m_weights[i]) {
+            return false;
+        }
+    }
+    if (m_constant != rhs.m_constant || m_low != rhs.m_low || m_high != rhs.m_high ||
+        m_terms.size() != rhs.m_terms.size()) {
+        return false;
+    }
+    for (int i = 0; i < (int)m_terms.size(); i++) {
+        if (m_terms[i].m_vital != rhs.m_terms[i].m_vital ||
+            m_terms[i].m_threshold != rhs.m_terms[i].m_threshold ||
+            m_terms[i].m_weight != rhs.m_terms[i].m_weight) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// e.g. "policy 1 constant 0 weights 1 0 1 1 0 clamp -2147483648 2147483647
+// terms 1 0 38 5", where the 1 after policy is the version of the format
+string PriorityPolicy::serialize() const {
+    ostringstream out;
+    out << "policy 1 constant " << m_constant << " weights";
+    for (int i = 0; i < NUMVITALS; i++) {
+        out << " " << m_weights[i];
+    }
+    out << " clamp " << m_low << " " << m_high << " terms " << m_terms.size();
+    for (int i = 0; i < (int)m_terms.size(); i++) {
+        out << " " << m_terms[i].m_vital << " " << m_terms[i].m_threshold
+            << " " << m_terms[i].m_weight;
+    }
+    return out.str();
+}
+
+PriorityPolicy PriorityPolicy::deserialize(const string& text) {
+    istringstream in(text);
+    string word;
+    int version = 0;
+    PriorityPolicy policy;
+    if (!(in >> word) || word != "policy" || !(in >> version) || version != 1 ||
+        !(in >> word) || word != "constant" || !(in >> policy.m_constant) ||
+        !(in >> word) || word != "weights") {
+        throw domain_error("Not a priority policy");
+    }
+    for (int i = 0; i < NUMVITALS; i++) {
+        if (!(in >> policy.m_weights[i])) {
+            throw domain_error("Not a priority policy");
+        }
+    }
+    int low, high, count;
+    if (!(in >> word) || word != "clamp" || !(in >> low >> high) || low > high ||
+        !(in >> word) || word != "terms" || !(in >> count) || count < 0) {
+        throw domain_error("Not a priority policy");
+    }
+    policy.m_low = low;
+    policy.m_high = high;
+    for (int i = 0; i < count; i++) {
+        int vital, threshold, weight;
+        if (!(in >> vital >> threshold >> weight) || vital < 0 || vital >= NUMVITALS) {
+            throw domain_error("Not a priority policy");
+        }
+        policy.addAbove(VITAL(vital), threshold, weight);
+    }
+    if (in >> word) {
+        throw domain_error("Not a priority policy");
+    }
+    return policy;
+}
+
+int PriorityPolicy::scoreVitals(const int* vitals) const {
+    int sum = m_constant;
+    for (int i = 0; i < NUMVITALS; i++) {
+        sum += m_weights[i] * vitals[i];
+    }
+    for (int i = 0; i < (int)m_terms.size(); i++) {
+        int above = vitals[m_terms[i].m_vital] - m_terms[i].m_threshold;
+        if (above > 0) {
+            sum += m_terms[i].m_weight * above;
+        }
+    }
+    if (sum < m_low) {
+        return m_low;
+    }
+    return (sum > m_high) ? m_high : sum;
+}
+
+void VitalsColumns::resize(int count) {
+    for (int i = 0; i < NUMVITALS; i++) {
+        m_columns[i].resize(count);
+    }
+}
+
+void VitalsColumns::reserve(int count) {
+    for (int i = 0; i < NUMVITALS; i++) {
+        m_columns[i].reserve(count);
+    }
+}
+
+// A policy worked out for one batch: only the vitals with a weight are
+// read, and every term already points at its column
+struct ScorePlan {
+    ScorePlan(const PriorityPolicy& policy, const VitalsColumns& vitals);
+    int m_constant;
+    int m_count;                     // vitals with a weight
+    const int* m_columns[NUMVITALS];
+    int m_weights[NUMVITALS];
+    vector<const int*> m_termColumns;
+    const vector<PriorityPolicy::Term>& m_terms;
+    bool m_clamp;
+    int m_low;
+    int m_high;
+};
+
+ScorePlan::ScorePlan(const PriorityPolicy& policy, const VitalsColumns& vitals)
+    : m_terms(policy.getTerms()) {
+    m_constant = policy.getConstant();
+    m_count = 0;
+    for (int i = 0; i < NUMVITALS; i++) {
+        if (policy.getWeight(VITAL(i)) != 0) {
+            m_columns[m_count] = vitals.m_columns[i].data();
+            m_weights[m_count] = policy.getWeight(VITAL(i));
+            m_count++;
+        }
+    }
+    for (int i = 0; i < (int)m_terms.size(); i++) {
+        m_termColumns.push_back(vitals.m_columns[m_terms[i].m_vital].data());
+    }
+    m_low = policy.getClampLow();
+    m_high = policy.getClampHigh();
+    m_clamp = (m_low != INT_MIN || m_high != INT_MAX);
+}
+
+// scores the patients from first to count one at a time, also used for
+// what is left after the last full SIMD vector
+static void scoreScalar(const ScorePlan& plan, int* keys, int first, int count) {
+    for (int i = first; i < count; i++) {
+        int sum = plan.m_constant;
+        for (int k = 0; k < plan.m_count; k++) {
+            sum += plan.m_weights[k] * plan.m_columns[k][i];
+        }
+        for (int k = 0; k < (int)plan.m_terms.size(); k++) {
+            int above = plan.m_termColumns[k][i] - plan.m_terms[k].m_threshold;
+            if (above > 0) {
+                sum += plan.m_terms[k].m_weight * above;
+            }
+        }
+        if (plan.m_clamp) {
+            sum = (sum < plan.m_low) ? plan.m_low : (sum > plan.m_high) ? plan.m_high : sum;
+        }
+        keys[i] = sum;
+    }
+}
+
+#ifdef PQUEUE_X86_SIMD
+// The target attributes let these use AVX2 and SSE4.1 without compiling
+// the rest of the program for them, bestSimdLevel makes sure the
+// processor has them before they are called.
+__attribute__((target("avx2")))
+static void scoreAVX2(const ScorePlan& plan, int* keys, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i low = _mm256_set1_epi32(plan.m_low);
+    const __m256i high = _mm256_set1_epi32(plan.m_high);
+    int terms = (int)plan.m_terms.size();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i sum = _mm256_set1_epi32(plan.m_constant);
+        for (int k = 0; k < plan.m_count; k++) {
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_set1_epi32(plan.m_weights[k]),
+                  _mm256_loadu_si256((const __m256i*)&plan.m_columns[k][i])));
+        }
+        for (int k = 0; k < terms; k++) {
+            __m256i above = _mm256_sub_epi32(
+                _mm256_loadu_si256((const __m256i*)&plan.m_termColumns[k][i]),
+                _mm256_set1_epi32(plan.m_terms[k].m_threshold));
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(
+                  _mm256_set1_epi32(plan.m_terms[k].m_weight), _mm256_max_epi32(above, zero)));
+        }
+        if (plan.m_clamp) {
+            sum = _mm256_min_epi32(_mm256_max_epi32(sum, low), high);
+        }
+        _mm256_storeu_si256((__m256i*)&keys[i], sum);
+    }
+    scoreScalar(plan, keys, i, count);
+}
+
+// SSE2 has no 32 bit multiply, so this needs SSE4.1
+__attribute__((target("sse4.1")))
+static void scoreSSE41(const ScorePlan& plan, int* keys, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i low = _mm_set1_epi32(plan.m_low);
+    const __m128i high = _mm_set1_epi32(plan.m_high);
+    int terms = (int)plan.m_terms.size();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i sum = _mm_set1_epi32(plan.m_constant);
+        for (int k = 0; k < plan.m_count; k++) {
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_set1_epi32(plan.m_weights[k]),
+                  _mm_loadu_si128((const __m128i*)&plan.m_columns[k][i])));
+        }
+        for (int k = 0; k < terms; k++) {
+            __m128i above = _mm_sub_epi32(
+                _mm_loadu_si128((const __m128i*)&plan.m_termColumns[k][i]),
+                _mm_set1_epi32(plan.m_terms[k].m_threshold));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(
+                  _mm_set1_epi32(plan.m_terms[k].m_weight), _mm_max_epi32(above, zero)));
+        }
+        if (plan.m_clamp) {
+            sum = _mm_min_epi32(_mm_max_epi32(sum, low), high);
+        }
+        _mm_storeu_si128((__m128i*)&keys[i], sum);
+    }
+    scoreScalar(plan, keys, i, count);
+}
+#endif
+
+SIMDLEVEL bestSimdLevel() {
+#ifdef PQUEUE_X86_SIMD
+    // the answer never changes, so the processor is only asked once
+    static const SIMDLEVEL best = __builtin_cpu_supports("avx2") ? AVX2 :
+                                  __builtin_cpu_supports("sse4.1") ? SSE41 : SCALAR;
+    return best;
+#else
+    return SCALAR;
+#endif
+}
+
+void scoreBatch(const PriorityPolicy& policy, const VitalsColumns& vitals, int* keys,
+                SIMDLEVEL level) {
+    if (level > bestSimdLevel()) {
+        level = bestSimdLevel();
+    }
+    ScorePlan plan(policy, vitals);
+#ifdef PQUEUE_X86_SIMD
+    if (level == AVX2) {
+        scoreAVX2(plan, keys, vitals.size());
+        return;
+    }
+    if (level == SSE41) {
+        scoreSSE41(plan, keys, vitals.size());
+        return;
+    }
+#endif
+    scoreScalar(plan, keys, 0, vitals.size());
+}
+
+// Snapshot files hold every number in the byte order of the machine that
+// wrote them:
+//   "PQSN", uint32 version, uint32 0x01020304 (shows the byte order)
+//   uint8 heap type, uint8 structure, uint8 has a policy, uint8 0
+//   int32 arity, int32 size, int32 cancelled, double compaction threshold
+//   uint32 length of the policy text, the text from PriorityPolicy::serialize
+//   size records, the nodes in preorder or the DARY entries in level order:
+//     uint8 flags (1 has a left child, 2 has a right child, 4 cancelled)
+//     int32 key, int32 NPL, int32 temperature, oxygen, RR, BP and opinion
+//     uint32 length of the name, the name
+const uint32_t SNAPSHOTVERSION = 1;
+const uint32_t SNAPSHOTORDER = 0x01020304;
+const size_t SNAPSHOTRECORD = 33; // bytes in a record with an empty name
+const uint8_t SNAPSHOTLEFT = 1;
+const uint8_t SNAPSHOTRIGHT = 2;
+const uint8_t SNAPSHOTDEAD = 4;
+
+// Buffers the snapshot and writes it to the file 64KB at a time
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const string& path)
+        : m_file(path.c_str(), ios::binary | ios::trunc), m_path(path) {
+        if (!m_file) {
+            throw runtime_error("Can not write the snapshot " + path);
+        }
+    }
+    void put8(uint8_t value) {m_buffer.push_back(char(value));}
+    void put32(uint32_t value) {putBytes(&value, sizeof(value));}
+    void putString(const string& text) {
+        put32((uint32_t)text.size());
+        putBytes(text.data(), text.size());
+    }
+    void putBytes(const void* data, size_t count) {
+        m_buffer.append((const char*)data, count);
+        if (m_buffer.size() >= 65536) {
+            flush();
+        }
+    }
+    void close() {
+        flush();
+        m_file.close();
+        if (m_file.fail()) {
+            throw runtime_error("Can not write the snapshot " + m_path);
+        }
+    }
+private:
+    ofstream m_file;
+    string m_path;
+    string m_buffer;
+
+    void flush() {
+        m_file.write(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+        if (!m_file) {
+            throw runtime_error("Can not write the snapshot " + m_path);
+        }
+    }
+};
+
+// Reads a snapshot out of memory, every read is checked against the end
+class SnapshotReader {
+public:
+    SnapshotReader(const char* data, size_t size) : m_data(data), m_size(size), m_pos(0) {}
+    uint8_t get8() {
+        need(1);
+        return uint8_t(m_data[m_pos++]);
+    }
+    uint32_t get32() {
+        uint32_t value;
+        getBytes(&value, sizeof(value));
+        return value;
+    }
+    string getString() {
+        uint32_t length = get32();
+        need(length);
+        string text(m_data + m_pos, length);
+        m_pos += length;
+        return text;
+    }
+    void getBytes(void* data, size_t count) {
+        need(count);
+        memcpy(data, m_data + m_pos, count);
+        m_pos += count;
+    }
+    size_t remaining() const {return m_size - m_pos;}
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_pos;
+
+    void need(size_t count) {
+        if (m_size - m_pos < count) {
+            throw domain_error("The snapshot is cut short");
+        }
+    }
+};
+
+// The bytes of a whole file, mapped into memory where there is mmap and
+// read in one go where there is not or mapping fails
+class MappedFile {
+public:
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+    const char* data() const {return m_data;}
+    size_t size() const {return m_size;}
+private:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    vector<char> m_copy;
+
+    MappedFile(const MappedFile& rhs);            // not copyable
+    MappedFile& operator=(const MappedFile& rhs); // not copyable
+};
+
+MappedFile::MappedFile(const string& path) : m_data(nullptr), m_size(0), m_mapped(false) {
+#ifdef PQUEUE_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can not read the snapshot " + path);
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            // the snapshot is read front to back once
+            madvise(data, info.st_size, MADV_SEQUENTIAL);
+            m_data = (const char*)data;
+            m_size = info.st_size;
+            m_mapped = true;
+        }
+    }
+    ::close(fd);
+    if (m_mapped) {
+        return;
+    }
+#endif
+    ifstream file(path.c_str(), ios::binary);
+    if (!file) {
+        throw runtime_error("Can not read the snapshot " + path);
+    }
+    m_copy.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    m_data = m_copy.data();
+    m_size = m_copy.size();
+}
+
+MappedFile::~MappedFile() {
+#ifdef PQUEUE_MMAP
+    if (m_mapped) {
+        munmap((void*)m_data, m_size);
+    }
+#endif
+}
+
+template <class Record>
+static void putRecord(SnapshotWriter& out, const Record& patient, int key, int npl,
+                      uint8_t flags) {
+    out.put8(flags);
+    out.put32(key);
+    out.put32(npl);
+    out.put32(patient.getTemperature());
+    out.put32(patient.getOxygen());
+    out.put32(patient.getRR());
+    out.put32(patient.getBP());
+    out.put32(patient.getOpinion());
+    out.putString(patient.getPatient());
+}
+
+// the setters keep vitals that are out of range, like PackedPatient::unpack
+template <class Record>
+static Record getRecord(SnapshotReader& in, uint8_t& flags, int& key, int& npl) {
+    flags = in.get8();
+    key = (int)in.get32();
+    npl = (int)in.get32();
+    Patient patient;
+    patient.setTemperature((int)in.get32());
+    patient.setOxygen((int)in.get32());
+    patient.setRR((int)in.get32());
+    patient.setBP((int)in.get32());
+    patient.setOpinion((int)in.get32());
+    patient.setPatient(in.getString());
+    return Record(std::move(patient));
+}
+
+template <class Record>
+void PQueueOf<Record>::saveSnapshot(const string& path) const {
+    SnapshotWriter out(path);
+    out.putBytes("PQSN", 4);
+    out.put32(SNAPSHOTVERSION);
+    out.put32(SNAPSHOTORDER);
+    out.put8(m_heapType);
+    out.put8(m_structure);
+    out.put8(m_hasPolicy ? 1 : 0);
+    out.put8(0);
+    out.put32(m_arity);
+    out.put32(m_size);
+    out.put32(m_cancelled);
+    out.putBytes(&m_compactThreshold, sizeof(m_compactThreshold));
+    out.putString(m_hasPolicy ? m_policy.serialize() : string());
+
+    if (m_structure == DARY) {
+        for (int i = 0; i < m_size; i++) {
+            putRecord(out, m_patients[m_entries[i].m_slot], m_entries[i].m_key, 0, 0);
+        }
+        out.close();
+        return;
+    }
+
+    // preorder, so loading can link every node as soon as it is read
+    vector<const Node*> stack;
+    if (m_heap) {
+        stack.push_back(m_heap);
+    }
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        uint8_t flags = (node->m_left ? SNAPSHOTLEFT : 0) | (node->m_right ? SNAPSHOTRIGHT : 0) |
+                        (node->m_dead ? SNAPSHOTDEAD : 0);
+        putRecord(out, node->m_patient, node->m_key, node->m_npl, flags);
+        if (node->m_right) {
+            stack.push_back(node->m_right);
+        }
+        if (node->m_left) {
+            stack.push_back(node->m_left);
+        }
+    }
+    out.close();
+}
+
+// Builds the snapshot in a queue of its own and only moves it into this
+// one once all of it has been read and checked
+template <class Record>
+void PQueueOf<Record>::loadSnapshot(const string& path) {
+    MappedFile file(path);
+    SnapshotReader in(file.data(), file.size());
+    char magic[4];
+    in.getBytes(magic, 4);
+    if (memcmp(magic, "PQSN", 4) != 0) {
+        throw domain_error("Not a snapshot");
+    }
+    if (in.get32() != SNAPSHOTVERSION) {
+        throw domain_error("The snapshot has an unknown version");
+    }
+    if (in.get32() != SNAPSHOTORDER) {
+        throw domain_error("The snapshot has the wrong byte order");
+    }
+    int heapType = in.get8();
+    int structure = in.get8();
+    int hasPolicy = in.get8();
+    in.get8();
+    int arity = (int)in.get32();
+    int size = (int)in.get32();
+    int cancelled = (int)in.get32();
+    double threshold;
+    in.getBytes(&threshold, sizeof(threshold));
+    string policy = in.getString();
+    // a record takes at least SNAPSHOTRECORD bytes, so a size that does not
+    // fit in the file is caught before reserving anything
+    if (heapType > MAXHEAP || structure > PAIRING || hasPolicy > 1 || arity < 2 ||
+        size < 0 || (size_t)size > in.remaining() / SNAPSHOTRECORD ||
+        cancelled < 0 || cancelled > size || !(threshold >= 0 && threshold <= 1)) {
+        throw domain_error("The snapshot is damaged");
+    }
+    if (!hasPolicy && m_hasPolicy) {
+        throw domain_error("The snapshot needs a priority function");
+    }
+
+    PQueueOf loaded(m_priorFunc, HEAPTYPE(heapType), STRUCTURE(structure), arity);
+    if (hasPolicy) {
+        loaded.m_policy = PriorityPolicy::deserialize(policy);
+        loaded.m_hasPolicy = true;
+        loaded.m_priorFunc = nullptr;
+    }
+    loaded.m_compactThreshold = threshold;
+
+    uint8_t flags;
+    int key, npl;
+    if (loaded.m_structure == DARY) {
+        if (cancelled != 0) {
+            throw domain_error("The snapshot is damaged");
+        }
+        loaded.m_entries.reserve(size);
+        loaded.m_patients.reserve(size);
+        loaded.m_positions.reserve(size);
+        for (int i = 0; i < size; i++) {
+            Record patient = getRecord<Record>(in, flags, key, npl);
+            loaded.appendEntry(std::move(patient), key);
+        }
+    }
+    else {
+        // pendingLeft is the node whose left child comes next, otherwise it
+        // is the right child of the last node in needRight
+        Node* pendingLeft = nullptr;
+        vector<Node*> needRight;
+        int dead = 0;
+        for (int i = 0; i < size; i++) {
+            if (i > 0 && !pendingLeft && needRight.empty()) {
+                throw domain_error("The snapshot is damaged");
+            }
+            Record patient = getRecord<Record>(in, flags, key, npl);
+            Node* node = loaded.m_pool.allocate(std::move(patient), key);
+            node->m_npl = npl;
+            node->m_dead = (flags & SNAPSHOTDEAD) != 0;
+            dead += node->m_dead ? 1 : 0;
+            if (i == 0) {
+                loaded.m_heap = node;
+            }
+            else if (pendingLeft) {
+                pendingLeft->m_left = node;
+                node->m_parent = pendingLeft;
+            }
+            else {
+                needRight.back()->m_right = node;
+                node->m_parent = needRight.back();
+                needRight.pop_back();
+            }
+            if (flags & SNAPSHOTRIGHT) {
+                needRight.push_back(node);
+            }
+            pendingLeft = (flags & SNAPSHOTLEFT) ? node : nullptr;
+        }
+        loaded.m_size = size;
+        loaded.m_cancelled = cancelled;
+        if (pendingLeft || !needRight.empty() || dead != cancelled ||
+            (loaded.m_heap && loaded.m_heap->m_dead)) {
+            throw domain_error("The snapshot is damaged");
+        }
+    }
+    if (in.remaining() != 0) {
+        throw domain_error("The snapshot is damaged");
+    }
+    *this = std::move(loaded);
+}
+
+// from here down are functions to help with testing
+
+template <class Record>
+bool PQueueOf<Record>::heapPropertyMinTest() {
+    if (m_structure == DARY) {
+        return m_heapType == MINHEAP && heapPropertyArray();
+    }
+    if (m_structure == PAIRING) {
+        return m_heapType == MINHEAP && heapPropertyPairing();
+    }
+    return heapPropertyMin(m_heap);
+}
+
+template <class Record>
+bool PQueueOf<Record>::heapPropertyMin(Node* ptr) {
+    if (ptr == nullptr) {
+        return true;
+    }
+
+    if (ptr->m_left && ptr->m_key > ptr->m_left->m_key) {
+        return false;
+    }
+    if (ptr->m_right && ptr->m_key > ptr->m_right->m_key) {
+        return false;
+    }
+
+    return heapPropertyMin(ptr->m_left) && heapPropertyMin(ptr->m_right);
+}
+
+template <class Record>
+bool PQueueOf<Record>::heapPropertyMaxTest() {
+    if (m_structure == DARY) {
+        return m_heapType == MAXHEAP && heapPropertyArray();
+    }
+    if (m_structure == PAIRING) {
+        return m_heapType == MAXHEAP && heapPropertyPairing();
+    }
+    return heapPropertyMax(m_heap);
+}
+
+// no node may have a higher priority than its parent, which for a node on
+// a sibling list is the parent of the first sibling
+template <class Record>
+bool PQueueOf<Record>::heapPropertyPairing() const {
+    vector<pair<Node*, Node*> > stack; // (node, parent)
+    if (m_heap != nullptr) {
+        if (m_heap->m_right != nullptr) {
+            return false;
+        }
+        stack.push_back(make_pair(m_heap, (Node*)nullptr));
+    }
+    while (!stack.empty()) {
+        Node* node = stack.back().first;
+        Node* parent = stack.back().second;
+        stack.pop_back();
+        if (parent && higherKey(node->m_key, parent->m_key)) {
+            return false;
+        }
+        if (node->m_left) stack.push_back(make_pair(node->m_left, node));
+        if (node->m_right) stack.push_back(make_pair(node->m_right, parent));
+    }
+    return true;
+}
+
+// no entry may have a higher priority than its parent
+template <class Record>
+bool PQueueOf<Record>::heapPropertyArray() const {
+    for (int i = 1; i < m_size; i++) {
+        if (higherKey(m_entries[i].m_key, m_entries[(i - 1) / m_arity].m_key)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Record>
+bool PQueueOf<Record>::heapPropertyMax(Node* ptr) {
+    if (ptr == nullptr) {
+        return true;
+    }
+
+    if (ptr->m_left && ptr->m_key < ptr->m_left->m_key) {
+        return false;
+    }
+    if (ptr->m_right && ptr->m_key < ptr->m_right->m_key) {
+        return false;
+    }
+
+    return heapPropertyMax(ptr->m_left) && heapPropertyMax(ptr->m_right);
+}
+
+template <class Record>
+bool PQueueOf<Record>::leftistProperty(Node* ptr) {
+    if (ptr == nullptr) {
+        return true;
+    }
+
+    if (NPL(ptr->m_left) < NPL(ptr->m_right)) {
+        return false;
+    }
+
+    return leftistProperty(ptr->m_left) && leftistProperty(ptr->m_right);
+}
+
+template <class Record>
+bool PQueueOf<Record>::testNPL(Node* ptr) {
+    if (ptr == nullptr) {
+        return true;
+    }
+
+    int leftNPL = NPL(ptr->m_left);
+    int rightNPL = NPL(ptr->m_right);
+
+    if (ptr->m_npl != min(leftNPL, rightNPL) + 1) {
+        return false;
+    }
+
+    return testNPL(ptr->m_left) && testNPL(ptr->m_right);
+}
+
+StatsHistogram::StatsHistogram() {
+    reset();
+}
+
+void StatsHistogram::add(const StatsHistogram& rhs) {
+    for (int i = 0; i < NUMBUCKETS; i++) {
+        m_counts[i] += rhs.m_counts[i];
+    }
+    if (rhs.m_count > 0 && (m_count == 0 || rhs.m_min < m_min)) {
+        m_min = rhs.m_min;
+    }
+    if (rhs.m_max > m_max) {
+        m_max = rhs.m_max;
+    }
+    m_count += rhs.m_count;
+    m_sum += rhs.m_sum;
+}
+
+void StatsHistogram::reset() {
+    memset(m_counts, 0, sizeof(m_counts));
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+    m_sum = 0;
+}
+
+double StatsHistogram::mean() const {
+    return (m_count > 0) ? (double)m_sum / m_count : 0;
+}
+
+// walks the buckets until it has passed fraction of the values, the last
+// bucket holds everything too big to tell apart so it stops at m_max
+uint64_t StatsHistogram::percentile(double fraction) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    long long rank = (long long)(fraction * m_count + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    }
+    long long seen = 0;
+    for (int i = 0; i < NUMBUCKETS; i++) {
+        seen += (long long)m_counts[i];
+        if (seen >= rank) {
+            return (i == NUMBUCKETS - 1) ? m_max : std::min(highestIn(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+uint64_t StatsHistogram::highestIn(int bucket) {
+    if (bucket < LINEARBUCKETS) {
+        return (uint64_t)bucket;
+    }
+    int bits = (bucket - LINEARBUCKETS) / (1 << SUBBITS) + LINEARBITS;
+    uint64_t sub = (bucket - LINEARBUCKETS) % (1 << SUBBITS);
+    uint64_t width = (uint64_t)1 << (bits - SUBBITS);
+    return (((uint64_t)1 << SUBBITS) + sub) * width + width - 1;
+}
+
+HeapReport::HeapReport() {
+    m_nodes = 0;
+    m_rightSpine = 0;
+    m_maxDepth = 0;
+    m_averageDepth = 0;
+    m_depthRatio = 0;
+    m_imbalance = 0;
+}
+
+PQueueStats::PQueueStats() {
+#ifdef PQUEUE_STATS
+    m_enabled = true;
+#else
+    m_enabled = false;
+#endif
+    m_merges = 0;
+    m_comparisons = 0;
+    m_priorityCalls = 0;
+    m_nodeAllocations = 0;
+    m_nplUpdates = 0;
+}
+
+PQueueStats& PQueueStats::operator+=(const PQueueStats& rhs) {
+    m_merges += rhs.m_merges;
+    m_comparisons += rhs.m_comparisons;
+    m_priorityCalls += rhs.m_priorityCalls;
+    m_nodeAllocations += rhs.m_nodeAllocations;
+    m_nplUpdates += rhs.m_nplUpdates;
+    m_mergePath.add(rhs.m_mergePath);
+    m_insertNanos.add(rhs.m_insertNanos);
+    m_getNextNanos.add(rhs.m_getNextNanos);
+    m_mergeNanos.add(rhs.m_mergeNanos);
+    return *this;
+}
+
+static void printHistogram(ostream& sout, const char* name, const StatsHistogram& histogram) {
+    sout << name << "_count " << histogram.count() << "\n"
+         << name << "_mean " << histogram.mean() << "\n"
+         << name << "_p50 " << histogram.percentile(0.5) << "\n"
+         << name << "_p99 " << histogram.percentile(0.99) << "\n"
+         << name << "_p999 " << histogram.percentile(0.999) << "\n"
+         << name << "_max " << histogram.maxValue() << "\n";
+}
+
+ostream& operator<<(ostream& sout, const PQueueStats& stats) {
+    sout << "enabled " << (stats.m_enabled ? 1 : 0) << "\n"
+         << "merges " << stats.m_merges << "\n"
+         << "comparisons " << stats.m_comparisons << "\n"
+         << "priority_calls " << stats.m_priorityCalls << "\n"
+         << "node_allocations " << stats.m_nodeAllocations << "\n"
+         << "npl_updates " << stats.m_nplUpdates << "\n";
+    printHistogram(sout, "merge_path", stats.m_mergePath);
+    printHistogram(sout, "insert_ns", stats.m_insertNanos);
+    printHistogram(sout, "get_next_ns", stats.m_getNextNanos);
+    printHistogram(sout, "merge_ns", stats.m_mergeNanos);
+    return sout;
+}
+
+// every member is compiled here for the two kinds of records, so the
+// definitions can stay out of the header
+template class NodePoolOf<Patient>;
+template class NodePoolOf<PackedPatient>;
+template class PQueueOf<Patient>;
+template class PQueueOf<PackedPatient>;
@@ -5,15 +5,34 @@
 #include <stdexcept>
 #include <iostream>
 #include <string>
+#include <vector>
+#include <utility>
+#include <new>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <unordered_map>
+#include <mutex>
+#include <type_traits>
+#ifdef PQUEUE_STATS
+#include <chrono>
+#endif
 using namespace std;
 
 class Grader; // forward declaration (for grading purposes)
 class Tester; // forward declaration (for test functions)
 class PQueue; // forward declaration
+template <class Record> class PQueueOf; // forward declaration
+struct HeapKernels; // forward declaration
+class ConcurrentPQueue; // forward declaration
 class Patient;// forward declaration
 #define EMPTY Patient() // This is an empty object (invalid patient)
 enum HEAPTYPE {MINHEAP, MAXHEAP};
-enum STRUCTURE {SKEW, LEFTIST};
+// DARY is an array based d-ary heap, the others are pointer based
+enum STRUCTURE {SKEW, LEFTIST, DARY, PAIRING};
+template <class Priority, class Compare, STRUCTURE Structure>
+class BasicPQueue; // forward declaration
 // Priority function pointer type
 typedef int (*prifn_t)(const Patient&);
 
@@ -50,7 +69,7 @@ class Patient {
             m_RR = 20; m_BP = 100;m_opinion=10;
         }
         else{
-            m_patient = name; m_temperature = temp; m_oxygen = ox;
+            m_patient = std::move(name); m_temperature = temp; m_oxygen = ox;
             m_RR = rr; m_BP = bp;m_opinion=op;
         }
     }
@@ -60,12 +79,27 @@ class Patient {
     int getRR() const {return m_RR;}
     int getBP() const {return m_BP;}
     int getOpinion() const {return m_opinion;}
-    void setPatient(string name) {m_patient=name;}
+    void setPatient(string name) {m_patient=std::move(name);}
     void setTemperature(int val) {m_temperature=val;}
     void setOxygen(int val) {m_oxygen=val;}
     void setRR(int val) {m_RR=val;}
     void setBP(int val) {m_BP=val;}
     void setOpinion(int val) {m_opinion=val;}
+    // Copy and move constructors, moving takes over the name string
+    Patient(const Patient& rhs) = default;
+    Patient(Patient&& rhs) noexcept = default;
+    // Overloaded move assignment operator
+    Patient & operator=(Patient&& rhs) noexcept {
+        if (this != &rhs){
+            m_patient = std::move(rhs.m_patient);
+            m_temperature = rhs.m_temperature;
+            m_oxygen = rhs.m_oxygen;
+            m_RR = rhs.m_RR;
+            m_BP = rhs.m_BP;
+            m_opinion = rhs.m_opinion;
+        }
+        return *this;
+    }
     // Overloaded assignment operator
     const Patient & operator=(const Patient& rhs){
         if (this != &rhs){
@@ -99,68 +133,954 @@ class Patient {
     int m_opinion;     // Nurse opinion, 1 - 10
 };
 
-class Node {
-    // this is a node in the skew/leftist heap
+class NameTable {
+    // Interns patient names, every distinct name is stored once and gets a
+    // 4 byte id.  Names are never removed, so an id stays valid for the
+    // whole program.  The table is thread safe, every packed patient in
+    // every queue uses the one shared table.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    static NameTable& shared();
+    uint32_t intern(const string& name);  // the id of name, added if new
+    string getName(uint32_t id) const;    // throws out_of_range for a bad id
+    // Sets id and returns true if name was interned, without adding it
+    bool findId(const string& name, uint32_t& id) const;
+    int size() const;                     // distinct names, "" included
+
+private:
+    NameTable();
+    NameTable(const NameTable& rhs);            // not copyable
+    NameTable& operator=(const NameTable& rhs); // not copyable
+
+    mutable mutex m_lock;                  // guards both members
+    unordered_map<string, uint32_t> m_ids; // id of each name
+    vector<const string*> m_names;         // name of each id, keys of m_ids
+};
+
+class PackedPatient {
+    // A patient in 12 bytes: the vitals take one byte each and the name is
+    // its id in NameTable::shared(), so a queued patient has no string of
+    // its own.  The getters are the same as those of Patient.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    PackedPatient(); // the empty patient, same as Patient()
+    // Interns the name.  Throws out_of_range if a vital does not fit in a
+    // byte, which only happens if a setter was given such a value.
+    explicit PackedPatient(const Patient& patient);
+    Patient unpack() const;
+    string getPatient() const {return NameTable::shared().getName(m_name);}
+    uint32_t getNameId() const {return m_name;}
+    int getTemperature() const {return m_temperature;}
+    int getOxygen() const {return m_oxygen;}
+    int getRR() const {return m_RR;}
+    int getBP() const {return m_BP;}
+    int getOpinion() const {return m_opinion;}
+    bool operator==(const PackedPatient& rhs) const;
+    // true if patient has the same name and vitals
+    bool operator==(const Patient& rhs) const;
+    // Overloaded insertion operator
+    friend ostream& operator<<(ostream& sout, const PackedPatient& patient);
+
+private:
+    uint32_t m_name;        // id of the name in NameTable::shared()
+    uint8_t m_temperature;  // same meaning as in Patient
+    uint8_t m_oxygen;
+    uint8_t m_RR;
+    uint8_t m_BP;
+    uint8_t m_opinion;
+};
+
+// The patient a priority function is called with for a stored record.  A
+// Patient is passed through as it is, a packed one is unpacked.
+inline const Patient& asPatient(const Patient& patient) {return patient;}
+inline Patient&& asPatient(Patient&& patient) {return std::move(patient);}
+inline Patient asPatient(const PackedPatient& patient) {return patient.unpack();}
+
+// The vitals a PriorityPolicy can weigh, in the order VitalsColumns keeps
+// them
+enum VITAL {TEMPERATURE, OXYGEN, RESPIRATORY, BLOODPRESSURE, OPINION, NUMVITALS};
+
+class PriorityPolicy {
+    // Describes a priority function instead of hiding it behind a
+    // prifn_t, so a queue can score whole batches of patients at once,
+    // compare two policies and save one.  The score of a patient is
+    //   constant + sum of weight * vital
+    //            + sum of weight * max(0, vital - threshold) over the terms
+    // clamped to [low, high].  The terms make it piecewise linear, e.g. a
+    // temperature that only counts above 38.  priorityFn1 is the policy with
+    // weight 1 on TEMPERATURE, RESPIRATORY and BLOODPRESSURE, priorityFn2
+    // the one with weight 1 on OXYGEN and OPINION.  The terms are kept
+    // sorted and merged, so two policies that describe the same function
+    // the same way compare equal however they were built.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    struct Term {
+        VITAL m_vital;
+        int m_threshold;
+        int m_weight;
+    };
+    PriorityPolicy(); // scores every patient 0
+    void setWeight(VITAL vital, int weight);
+    void setConstant(int constant);
+    // adds weight * max(0, vital - threshold)
+    void addAbove(VITAL vital, int threshold, int weight);
+    // adds weight * max(0, threshold - vital), stored as a linear part and
+    // an addAbove term so it has only one form
+    void addBelow(VITAL vital, int threshold, int weight);
+    // throws out_of_range if low > high
+    void setClamp(int low, int high);
+    int getWeight(VITAL vital) const {return m_weights[vital];}
+    int getConstant() const {return m_constant;}
+    int getClampLow() const {return m_low;}
+    int getClampHigh() const {return m_high;}
+    const vector<Term>& getTerms() const {return m_terms;}
+    // one patient, without SIMD.  Record is Patient or PackedPatient.
+    template <class Record>
+    int score(const Record& patient) const {
+        int vitals[NUMVITALS] = {patient.getTemperature(), patient.getOxygen(),
+                                 patient.getRR(), patient.getBP(), patient.getOpinion()};
+        return scoreVitals(vitals);
+    }
+    // so a policy can be the Priority of a BasicPQueue
+    int operator()(const Patient& patient) const {return score(patient);}
+    bool operator==(const PriorityPolicy& rhs) const;
+    bool operator!=(const PriorityPolicy& rhs) const {return !(*this == rhs);}
+    // A single line of text that deserialize turns back into an equal
+    // policy.  deserialize throws domain_error for text that is not one.
+    string serialize() const;
+    static PriorityPolicy deserialize(const string& text);
+private:
+    int m_weights[NUMVITALS];
+    int m_constant;
+    int m_low;   // the clamp, INT_MIN and INT_MAX when there is none
+    int m_high;
+    vector<Term> m_terms; // sorted by vital then threshold, no 0 weights
+
+    int scoreVitals(const int* vitals) const; // vitals in VITAL order
+};
+
+struct VitalsColumns {
+    // The vitals of a batch of patients as one array per vital (a struct
+    // of arrays), so scoreBatch loads the same vital of several patients
+    // with one instruction
+    template <class Record>
+    void add(const Record& patient) {
+        m_columns[TEMPERATURE].push_back(patient.getTemperature());
+        m_columns[OXYGEN].push_back(patient.getOxygen());
+        m_columns[RESPIRATORY].push_back(patient.getRR());
+        m_columns[BLOODPRESSURE].push_back(patient.getBP());
+        m_columns[OPINION].push_back(patient.getOpinion());
+    }
+    // stores the vitals of patient at index, which must be below size()
+    template <class Record>
+    void set(int index, const Record& patient) {
+        m_columns[TEMPERATURE][index] = patient.getTemperature();
+        m_columns[OXYGEN][index] = patient.getOxygen();
+        m_columns[RESPIRATORY][index] = patient.getRR();
+        m_columns[BLOODPRESSURE][index] = patient.getBP();
+        m_columns[OPINION][index] = patient.getOpinion();
+    }
+    void reserve(int count);
+    void resize(int count); // keeps the memory when it shrinks
+    int size() const {return (int)m_columns[TEMPERATURE].size();}
+    vector<int> m_columns[NUMVITALS]; // indexed by VITAL
+};
+
+// Instruction sets scoreBatch can use, from the slowest to the fastest
+enum SIMDLEVEL {SCALAR, SSE41, AVX2};
+SIMDLEVEL bestSimdLevel(); // the fastest one this processor has
+// Writes the score of every patient in vitals to keys, using level or the
+// fastest level the processor has if that is lower.  The SIMD paths are
+// only compiled for x86 with GCC or Clang, elsewhere it is always SCALAR.
+void scoreBatch(const PriorityPolicy& policy, const VitalsColumns& vitals, int* keys,
+                SIMDLEVEL level = AVX2);
+
+template <class Record>
+class NodeOf {
+    // this is a node in the skew/leftist/pairing heap.  In a pairing heap
+    // m_left is the first child and m_right is the next sibling, so
+    // m_parent is the parent of the first child and the previous sibling of
+    // the others.  Record is Patient or PackedPatient.
     public:
     friend class Grader; // for grading purposes
     friend class Tester; // contains test functions
-    friend class PQueue;
-    Node(Patient patient) {  
-        m_patient = patient;
+    template <class> friend class PQueueOf;
+    template <class, class, STRUCTURE> friend class BasicPQueue;
+    friend struct HeapKernels;
+    // Nodes stay where the pool put them, so they are built from a patient
+    // but are never copied or moved themselves
+    template <class P>
+    NodeOf(P&& patient, int key = 0) : m_patient(std::forward<P>(patient)) {
+        m_npl = 0;
+        m_key = key;
+        m_dead = false;
         m_right = nullptr;
         m_left = nullptr;
-        m_npl = 0;
+        m_parent = nullptr;
     }
-    Patient getPatient() const {return m_patient;}
+    Patient getPatient() const {return asPatient(m_patient);}
+    int getKey() const {return m_key;}
     void setNPL(int npl) {m_npl = npl;}
     int getNPL() const {return m_npl;}
 
     // Overloaded insertion operator
-    friend ostream& operator<<(ostream& sout, const Node& node);
+    friend ostream& operator<<(ostream& sout, const NodeOf& node) {
+        sout << node.m_patient;
+        return sout;
+    }
 
     private:
-    Patient m_patient;   // Patient information
-    Node *m_right;       // Right child
-    Node *m_left;        // Left child
+    // the small members come right after the patient, so they fill what
+    // would be padding between a PackedPatient and the pointers
+    Record m_patient;    // Patient information
     int m_npl;           // null path length for leftist heap
+    int m_key;           // priority of m_patient, cached when inserted
+    bool m_dead;         // cancelled, removed when it reaches the root
+    NodeOf *m_right;     // Right child
+    NodeOf *m_left;      // Left child
+    NodeOf *m_parent;    // the node whose m_left or m_right points here
+};
+typedef NodeOf<Patient> Node;
+
+struct HeapKernels {
+    // The merges of the pointer based heaps, shared by PQueueOf and
+    // BasicPQueue.  higher(key1, key2) is true if key1 has a strictly
+    // higher priority than key2.  It is a template parameter, so a queue
+    // that knows its order at compile time gets the comparisons inlined
+    // and PQueueOf picks the MINHEAP or MAXHEAP version once per merge
+    // instead of testing the heap type on every level.
+
+    // top-down skew merge, so the right spine length does not matter
+    template <class Record, class Higher>
+    static NodeOf<Record>* mergeSkew(NodeOf<Record>* p1, NodeOf<Record>* p2, Higher higher) {
+        if (!p1) return p2;
+        if (!p2) return p1;
+
+        NodeOf<Record>* root = nullptr;
+        NodeOf<Record>** link = &root; // where the next node of the merge path goes
+        NodeOf<Record>* owner = nullptr; // the node link belongs to
+        while (p1 && p2) {
+            if (higher(p2->m_key, p1->m_key)) {
+                swap(p1, p2);
+            }
+
+            // the old left child moves to the right and the rest of the
+            // merge goes on the left, same as merging right and then swapping
+            *link = p1;
+            p1->m_parent = owner;
+            NodeOf<Record>* next = p1->m_right;
+            p1->m_right = p1->m_left;
+            link = &p1->m_left;
+            owner = p1;
+            p1 = next;
+        }
+        *link = p1 ? p1 : p2;
+        (*link)->m_parent = owner;
+
+        return root;
+    }
+
+    // path is scratch space for the nodes on the merge path
+    template <class Record, class Higher>
+    static NodeOf<Record>* mergeLeftist(NodeOf<Record>* p1, NodeOf<Record>* p2,
+                                        vector<NodeOf<Record>*>& path, Higher higher) {
+        if (!p1) return p2;
+        if (!p2) return p1;
+
+        NodeOf<Record>* root = nullptr;
+        NodeOf<Record>** link = &root; // where the next node of the merge path goes
+        NodeOf<Record>* owner = nullptr; // the node link belongs to
+        path.clear();
+
+        // walks down the right spines, linking the higher priority node each time
+        while (p1 && p2) {
+            if (higher(p2->m_key, p1->m_key)) {
+                swap(p1, p2);
+            }
+
+            *link = p1;
+            p1->m_parent = owner;
+            path.push_back(p1);
+            link = &p1->m_right;
+            owner = p1;
+            p1 = p1->m_right;
+        }
+        *link = p1 ? p1 : p2;
+        (*link)->m_parent = owner;
+
+        // only nodes on the merge path can change, so going back up it swaps
+        // the children where needed and fixes their npl
+        for (int i = (int)path.size() - 1; i >= 0; i--) {
+            NodeOf<Record>* ptr = path[i];
+            if (!ptr->m_left || (ptr->m_left->m_npl < ptr->m_right->m_npl)) {
+                swap(ptr->m_left, ptr->m_right);
+            }
+            ptr->m_npl = (ptr->m_right ? ptr->m_right->m_npl : -1) + 1;
+        }
+
+        return root;
+    }
+
+    // Melds two pairing heap roots in O(1), the loser becomes the first
+    // child of the winner.  Roots never have siblings.
+    template <class Record, class Higher>
+    static NodeOf<Record>* mergePairing(NodeOf<Record>* p1, NodeOf<Record>* p2, Higher higher) {
+        if (!p1) return p2;
+        if (!p2) return p1;
+
+        if (higher(p2->m_key, p1->m_key)) {
+            swap(p1, p2);
+        }
+
+        p2->m_right = p1->m_left;
+        if (p2->m_right) {
+            p2->m_right->m_parent = p2;
+        }
+        p1->m_left = p2;
+        p2->m_parent = p1;
+
+        return p1;
+    }
+
+    // Two-pass pairing of a list of sibling heaps into one heap.  The first
+    // pass melds the siblings in pairs from left to right, the second melds
+    // the pairs into one heap from right to left.  path is scratch space
+    // for the pairs.
+    template <class Record, class Higher>
+    static NodeOf<Record>* combineSiblings(NodeOf<Record>* first,
+                                           vector<NodeOf<Record>*>& path, Higher higher) {
+        if (first == nullptr) {
+            return nullptr;
+        }
+
+        path.clear();
+        while (first) {
+            NodeOf<Record>* p1 = first;
+            NodeOf<Record>* p2 = p1->m_right;
+            if (p2 == nullptr) {
+                path.push_back(p1);
+                break;
+            }
+            first = p2->m_right;
+            p1->m_right = nullptr;
+            p2->m_right = nullptr;
+            path.push_back(mergePairing(p1, p2, higher));
+        }
+
+        NodeOf<Record>* root = path.back();
+        for (int i = (int)path.size() - 2; i >= 0; i--) {
+            root = mergePairing(path[i], root, higher);
+        }
+        root->m_parent = nullptr;
+
+        return root;
+    }
+};
+
+// orders for HeapKernels, the same as less<int> and greater<int>
+struct MinFirst {
+    bool operator()(int key1, int key2) const {return key1 < key2;}
+};
+struct MaxFirst {
+    bool operator()(int key1, int key2) const {return key1 > key2;}
 };
 
-class PQueue {
-    // stores the skew/leftist heap, minheap/maxheap
+template <class Record>
+class NodePoolOf {
+    // Slab allocator for the nodes of one queue.  Nodes are carved out of
+    // slabs that double in size and are recycled through a free list per
+    // slab, so once the queue has reached its working size inserting and
+    // removing patients does not allocate.  A slab that empties is freed
+    // if the other slabs can still hold as many nodes as the pool has ever
+    // held, so slabs taken over by adopt go back once their nodes leave.
+    // All slabs are freed at once by releaseAll instead of deleting the
+    // nodes one by one.
 public:
+    typedef NodeOf<Record> Node;
     friend class Grader; // for grading purposes
     friend class Tester; // contains test functions
-    PQueue(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure);
-    ~PQueue();
-    PQueue(const PQueue& rhs);
-    PQueue& operator=(const PQueue& rhs);
-    void insertPatient(const Patient& input);
+    NodePoolOf();
+    ~NodePoolOf();
+    // patient is a Record or a Patient to build the record from
+    // If the record can not be built the slot goes back and the exception
+    // is passed on
+    template <class P>
+    Node* allocate(P&& patient, int key) {
+        Slot* slot = takeSlot();
+        Node* node;
+        try {
+            node = new (slot->m_storage) Node(std::forward<P>(patient), key);
+        }
+        catch (...) {
+            returnSlot(slot);
+            throw;
+        }
+        slot->m_live = true;
+        return node;
+    }
+    // Builds the patient from args right in the node, the key is left at 0
+    template <class... Args>
+    Node* emplace(Args&&... args) {
+        Slot* slot = takeSlot();
+        Node* node;
+        try {
+            node = new (slot->m_storage) Node(Patient(std::forward<Args>(args)...));
+        }
+        catch (...) {
+            returnSlot(slot);
+            throw;
+        }
+        slot->m_live = true;
+        return node;
+    }
+    void release(Node* node);  // returns a node to the free list
+    void releaseAll();         // destroys every live node and frees all slabs
+    void collect(vector<Node*>& nodes) const; // adds every live node to nodes
+    void adopt(NodePoolOf& rhs); // takes over the slabs and nodes of rhs
+    void swap(NodePoolOf& rhs) noexcept; // swaps the slabs, without allocating
+    // Allocation counters, for checking the hot path does not allocate
+    int slabAllocations() const {return m_slabAllocations;} // calls to new[]
+    int nodeAllocations() const {return m_nodeAllocations;} // calls to allocate
+    int liveNodes() const {return m_live;}
+
+private:
+    struct Slab;
+    struct Slot {
+        alignas(Node) unsigned char m_storage[sizeof(Node)]; // must be first
+        union {
+            Slot* m_next;  // next free slot of the slab, while free
+            Slab* m_slab;  // the slab the slot is in, while live
+        };
+        bool m_live;   // true if m_storage holds a constructed Node
+    };
+    struct Slab {
+        Slot* m_slots;
+        int m_size;       // number of slots
+        int m_live;       // live nodes in the slots
+        int m_index;      // position in m_slabs
+        Slot* m_free;     // head of the free list of the slab
+        Slab* m_prevOpen; // neighbours in the list of slabs with free slots
+        Slab* m_nextOpen;
+    };
+    static const int MINSLAB = 16;   // nodes in the first slab
+    static const int MAXSLAB = 4096; // slabs stop doubling at this size
+
+    vector<Slab*> m_slabs;     // every slab owned by this pool
+    Slab* m_open;              // head of the list of slabs with free slots
+    long long m_capacity;      // slots in all the slabs
+    int m_highWater;           // most live nodes the pool has held
+    int m_nextSlabSize;
+    int m_live;
+    int m_slabAllocations;
+    int m_nodeAllocations;
+
+    NodePoolOf(const NodePoolOf& rhs);            // not copyable
+    NodePoolOf& operator=(const NodePoolOf& rhs); // not copyable
+    void addSlab();
+    Slot* takeSlot(); // pops a free slot of an open slab and counts it
+    void returnSlot(Slot* slot); // undoes takeSlot, the slot holds no node
+    void openSlab(Slab* slab);  // adds slab to the open list
+    void closeSlab(Slab* slab); // takes slab off the open list
+    void freeSlab(Slab* slab);  // deletes a slab that has no live nodes
+    bool spareSlab(const Slab* slab) const; // true if slab can be freed
+};
+typedef NodePoolOf<Patient> NodePool;
+
+template <class Record>
+class HandleOf {
+    // Refers to one queued patient, returned by insertPatient.  It stays
+    // valid until the patient leaves the queue, also through rebuilds and
+    // through merges into another queue of the same structure, except that
+    // setStructure to or from DARY and merging DARY queues invalidate it.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    template <class> friend class PQueueOf;
+    HandleOf() : m_node(nullptr), m_slot(-1) {} // refers to no patient
+    bool isNull() const {return m_node == nullptr && m_slot < 0;}
+
+private:
+    HandleOf(NodeOf<Record>* node, int slot) : m_node(node), m_slot(slot) {}
+    NodeOf<Record>* m_node;  // the node of the patient in a pointer based heap
+    int m_slot;              // the slot of the patient in a DARY heap
+};
+typedef HandleOf<Patient> PatientHandle;
+typedef HandleOf<PackedPatient> PackedHandle;
+
+class StatsHistogram {
+    // A log-linear histogram in the style of HdrHistogram.  Values below 32
+    // get a bucket each and every power of 2 above that is split into 16
+    // buckets, so a value is known to within 1/16 of itself.  Recording is
+    // a few instructions and never allocates.  Values of 2^36 and up (69
+    // seconds, in nanoseconds) share the last bucket.
+public:
+    StatsHistogram();
+    void record(uint64_t value) {
+        m_counts[bucketOf(value)]++;
+        if (m_count == 0 || value < m_min) {
+            m_min = value;
+        }
+        if (value > m_max) {
+            m_max = value;
+        }
+        m_count++;
+        m_sum += value;
+    }
+    void add(const StatsHistogram& rhs); // adds the values recorded in rhs
+    void reset();
+    long long count() const {return m_count;}
+    uint64_t minValue() const {return m_min;} // 0 if empty
+    uint64_t maxValue() const {return m_max;}
+    double mean() const;
+    // The smallest value that fraction of the recorded values are at or
+    // below, rounded up to the end of its bucket.  0 if empty.
+    uint64_t percentile(double fraction) const;
+
+private:
+    static const int LINEARBITS = 5;     // values below 2^LINEARBITS get a bucket each
+    static const int LINEARBUCKETS = 1 << LINEARBITS;
+    static const int SUBBITS = 4;        // 2^SUBBITS buckets per power of 2
+    static const int MAXBITS = 36;       // values from 2^MAXBITS share the last bucket
+    static const int NUMBUCKETS = LINEARBUCKETS + (MAXBITS - LINEARBITS) * (1 << SUBBITS);
+
+    uint64_t m_counts[NUMBUCKETS];
+    long long m_count;
+    uint64_t m_min;
+    uint64_t m_max;
+    uint64_t m_sum;
+
+    static int bucketOf(uint64_t value) {
+        if (value < (uint64_t)LINEARBUCKETS) {
+            return (int)value;
+        }
+        int bits = 63;
+#if defined(__GNUC__) || defined(__clang__)
+        bits = 63 - __builtin_clzll(value);
+#else
+        while (!(value >> bits)) {
+            bits--;
+        }
+#endif
+        if (bits >= MAXBITS) {
+            return NUMBUCKETS - 1;
+        }
+        int sub = (int)(value >> (bits - SUBBITS)) & ((1 << SUBBITS) - 1);
+        return LINEARBUCKETS + (bits - LINEARBITS) * (1 << SUBBITS) + sub;
+    }
+    static uint64_t highestIn(int bucket); // the largest value bucketOf puts in bucket
+};
+
+struct PQueueStats {
+    // What a queue built with PQUEUE_STATS defined counts, returned by
+    // PQueueOf::getStats.  The counts cover the calls made on one queue
+    // object: a copy or a queue that is moved into starts from its own
+    // counts.  PQUEUE_STATS changes the size of PQueueOf, so every file of
+    // a program has to be built with the same setting.
+    PQueueStats();
+    bool m_enabled;              // false if the queue was built without PQUEUE_STATS
+    long long m_merges;          // merges of two heaps, and sibling pairings
+    long long m_comparisons;     // key comparisons
+    long long m_priorityCalls;   // patients scored by the function or policy
+    long long m_nodeAllocations; // nodes taken from the pool
+    long long m_nplUpdates;      // NPLs changed by leftist merges and removals
+    StatsHistogram m_mergePath;  // right spine nodes walked per skew or leftist merge
+    StatsHistogram m_insertNanos;  // insertPatient
+    StatsHistogram m_getNextNanos; // getNextPatient
+    StatsHistogram m_mergeNanos;   // mergeWithQueue
+    // adds the stats of another queue, e.g. to total the shards of a queue
+    PQueueStats& operator+=(const PQueueStats& rhs);
+    // one "name value" line per counter and per histogram count, mean,
+    // p50, p99, p999 and max, for scraping
+    friend ostream& operator<<(ostream& sout, const PQueueStats& stats);
+};
+
+// The hooks PQueueOf counts with.  Without PQUEUE_STATS they are empty, so
+// the counting is compiled out.
+#ifdef PQUEUE_STATS
+// Records the nanoseconds from its construction to its destruction
+class StatsTimer {
+public:
+    explicit StatsTimer(StatsHistogram& histogram)
+        : m_histogram(histogram), m_start(chrono::steady_clock::now()) {}
+    ~StatsTimer() {
+        m_histogram.record((uint64_t)chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now() - m_start).count());
+    }
+private:
+    StatsHistogram& m_histogram;
+    chrono::steady_clock::time_point m_start;
+};
+// A HeapKernels order that counts its comparisons
+template <class Order>
+struct CountedOrder {
+    explicit CountedOrder(long long& count) : m_count(&count) {}
+    bool operator()(int key1, int key2) const {
+        (*m_count)++;
+        return Order()(key1, key2);
+    }
+    long long* m_count;
+};
+#define PQUEUE_COUNT(counter, amount) (m_stats.counter += (amount))
+#define PQUEUE_TIME(histogram) StatsTimer statsTimer(m_stats.histogram)
+#define PQUEUE_ORDER(Order) CountedOrder<Order>(m_stats.m_comparisons)
+#else
+#define PQUEUE_COUNT(counter, amount) ((void)0)
+#define PQUEUE_TIME(histogram) ((void)0)
+#define PQUEUE_ORDER(Order) Order()
+#endif
+
+struct HeapReport {
+    // The shape of a heap, made by PQueueOf::getHeapReport in one O(n)
+    // pass without printing anything.  Depths count edges, so the root is
+    // at depth 0.  A pairing heap is measured as the tree of children it
+    // stands for, not as its left child, right sibling nodes.
+    HeapReport();
+    int m_nodes;          // nodes in the heap, cancelled ones too
+    // Skew and leftist heaps: nodes on the path from the root through the
+    // right children, which every merge walks.  Pairing heaps: children of
+    // the root, which the next getNextPatient pairs up.  DARY heaps: nodes
+    // on the path through the last children.
+    int m_rightSpine;
+    int m_maxDepth;
+    double m_averageDepth;
+    // m_maxDepth over log2(m_nodes + 1), about 1 for a balanced tree and
+    // growing towards n / log2(n) as the heap turns into a list
+    double m_depthRatio;
+    // Skew and leftist heaps only: m_nplCounts[k] is the number of nodes
+    // with a null path length of k, measured on the tree, not m_npl
+    vector<int> m_nplCounts;
+    // Skew and leftist heaps only: the fraction of nodes whose right
+    // subtree has more nodes than the left.  These heavy nodes are the
+    // potential of the amortized skew heap analysis, so a high ratio means
+    // the coming merges walk long right paths.
+    double m_imbalance;
+};
+
+template <class Record>
+class PQueueOf {
+    // stores the skew/leftist heap, minheap/maxheap.  Record is how the
+    // queue stores its patients: PQueue keeps every Patient as it is and
+    // PackedPQueue keeps PackedPatients.  Patients go in and come out as
+    // Patient either way, the peeking functions return the stored Record.
+public:
+    friend class Grader; // for grading purposes
+    friend class Tester; // contains test functions
+    friend class ConcurrentPQueue; // reads the key at the root of each shard
+    typedef HandleOf<Record> Handle;
+    // arity is the number of children per node, only used by DARY heaps
+    PQueueOf(prifn_t priFn, HEAPTYPE heapType, STRUCTURE structure, int arity = 4);
+    // A queue that scores its patients with policy instead of a function
+    PQueueOf(const PriorityPolicy& policy, HEAPTYPE heapType, STRUCTURE structure,
+             int arity = 4);
+    // Builds the queue from a range of patients in O(n)
+    template <class InputIt>
+    PQueueOf(InputIt first, InputIt last, prifn_t priFn, HEAPTYPE heapType,
+             STRUCTURE structure, int arity = 4)
+        : PQueueOf(priFn, heapType, structure, arity) {
+        insertPatients(first, last);
+    }
+    ~PQueueOf();
+    PQueueOf(const PQueueOf& rhs);
+    PQueueOf& operator=(const PQueueOf& rhs);
+    // Move constructor and move assignment take over the nodes of rhs and
+    // leave it as an empty queue with the same priority function.  They
+    // do not allocate.  A PriorityPolicy is moved too, so rhs needs
+    // setPriorityPolicy before it is used with one again.
+    PQueueOf(PQueueOf&& rhs) noexcept;
+    PQueueOf& operator=(PQueueOf&& rhs) noexcept;
+    // Inserting returns a handle for updating or removing the patient later
+    Handle insertPatient(const Patient& input);
+    Handle insertPatient(Patient&& input);
+    // Builds the patient in place from the Patient constructor arguments
+    template <class... Args>
+    Handle emplacePatient(Args&&... args) {
+        if (m_structure == DARY) {
+            return insertPatient(Patient(std::forward<Args>(args)...));
+        }
+        Node* newNode = m_pool.emplace(std::forward<Args>(args)...);
+        PQUEUE_COUNT(m_nodeAllocations, 1);
+        try {
+            newNode->m_key = priorityOf(newNode->m_patient);
+        }
+        catch (...) {
+            m_pool.release(newNode);
+            throw;
+        }
+        m_heap = mergeNodes(m_heap, newNode);
+        m_size++;
+        return Handle(newNode, -1);
+    }
+    // Inserts a batch of patients with a single merge.  The batch is built
+    // into a heap in O(k) first, so adding k patients costs O(k + log n)
+    // instead of k separate inserts.  Pass move iterators to move the
+    // patients in instead of copying them.  If a patient can not be stored,
+    // e.g. a vital that does not fit a PackedPatient, the exception comes
+    // before the queue changes.
+    template <class InputIt>
+    void insertPatients(InputIt first, InputIt last) {
+        // The records are made and scored before the queue is touched, so
+        // a priority function that throws changes nothing.  Then the room
+        // for the batch is taken before any of it goes in.
+        vector<Record> batch;
+        vector<int> keys;
+        typedef typename iterator_traits<InputIt>::iterator_category Category;
+        if (is_base_of<forward_iterator_tag, Category>::value) {
+            batch.reserve(distance(first, last));
+            keys.reserve(batch.capacity());
+        }
+        for (; first != last; ++first) {
+            if (!m_hasPolicy) {
+                keys.push_back(m_priorFunc(asPatient(*first)));
+            }
+            batch.push_back(Record(*first));
+        }
+        int added = (int)batch.size();
+        if (m_hasPolicy) {
+            scoreRecords(batch, keys);
+        }
+        else {
+            PQUEUE_COUNT(m_priorityCalls, added);
+        }
+        if (m_structure == DARY) {
+            reserveEntries(added);
+            for (int i = 0; i < added; i++) {
+                appendEntry(std::move(batch[i]), keys[i]);
+            }
+            siftAppended(added);
+            return;
+        }
+        vector<Node*> nodes;
+        nodes.reserve(added);
+        try {
+            for (int i = 0; i < added; i++) {
+                nodes.push_back(m_pool.allocate(std::move(batch[i]), keys[i]));
+            }
+        }
+        catch (...) {
+            for (int i = 0; i < (int)nodes.size(); i++) {
+                m_pool.release(nodes[i]);
+            }
+            throw;
+        }
+        PQUEUE_COUNT(m_nodeAllocations, nodes.size());
+        m_size += (int)nodes.size();
+        m_heap = mergeNodes(m_heap, heapify(nodes));
+    }
+    void insertPatients(const Patient* patients, int count);
     Patient getNextPatient();
-    void mergeWithQueue(PQueue& rhs);
+    // Removes the k highest priority patients, or all of them if fewer are
+    // queued, and moves them to out in priority order.  Skew and leftist
+    // heaps take them out with a single meld.  Returns the number removed.
+    template <class OutputIt>
+    int getNextPatients(int k, OutputIt out) {
+        if (k > m_size - m_cancelled) {
+            k = m_size - m_cancelled;
+        }
+        if (k <= 0) {
+            return 0;
+        }
+        if (m_structure == SKEW || m_structure == LEFTIST) {
+            // taken also has the cancelled nodes found on the way
+            vector<Node*> taken;
+            takeTopNodes(k, taken);
+            for (int i = 0; i < (int)taken.size(); i++) {
+                if (!taken[i]->m_dead) {
+                    *out = asPatient(std::move(taken[i]->m_patient));
+                    ++out;
+                }
+                m_pool.release(taken[i]);
+            }
+            return k;
+        }
+        for (int i = 0; i < k; i++) {
+            *out = getNextPatient();
+            ++out;
+        }
+        return k;
+    }
+    // Returns the patient getNextPatient would return, without removing it.
+    // Throws out_of_range if the queue is empty.
+    const Record& peekNextPatient() const;
+
+    // Walks the queued patients in priority order without changing the
+    // queue.  The iterator keeps a small frontier heap of the nodes that
+    // can come next, the children of the nodes already visited, so seeing
+    // the first m patients costs O(m log m) whatever the size of the queue.
+    // Any change to the queue invalidates its iterators.
+    class const_iterator {
+    public:
+        typedef input_iterator_tag iterator_category;
+        typedef Record value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Record* pointer;
+        typedef const Record& reference;
+        const_iterator() : m_queue(nullptr) {} // the end of every queue
+        const Record& operator*() const;
+        const Record* operator->() const {return &**this;}
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const {return !(*this == rhs);}
+
+    private:
+        friend class PQueueOf<Record>;
+        struct Item {
+            int m_key;
+            const NodeOf<Record>* m_node; // the node, for pointer based heaps
+            int m_index;                  // the entry, for DARY heaps
+        };
+        // puts the highest priority item at the front of the frontier
+        struct Lower {
+            const PQueueOf* m_queue;
+            bool operator()(const Item& a, const Item& b) const {
+                return m_queue->higherKey(b.m_key, a.m_key);
+            }
+        };
+        const PQueueOf* m_queue; // nullptr once every patient was visited
+        Item m_current;
+        vector<Item> m_frontier; // heap of the candidates for the next patient
+
+        explicit const_iterator(const PQueueOf* queue);
+        void push(const NodeOf<Record>* node);
+        void push(int index);
+    };
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    // Copies the k highest priority patients to out in priority order and
+    // leaves the queue as it is.  Returns the number copied.
+    template <class OutputIt>
+    int peekTopK(int k, OutputIt out) const {
+        int copied = 0;
+        const_iterator it = begin();
+        while (copied < k && it != end()) {
+            *out = *it;
+            ++out;
+            // the children of the last patient are not needed
+            if (++copied < k) {
+                ++it;
+            }
+        }
+        return copied;
+    }
+    void mergeWithQueue(PQueueOf& rhs);
+    // Replaces the first queued patient equal to patient with updated and
+    // moves it to its new place in the heap.  Returns false if not found.
+    bool updatePatient(const Patient& patient, const Patient& updated);
+    // Replaces the patient of handle with updated and moves it to its new
+    // place in O(log n), amortized for skew and pairing heaps.  The handle
+    // stays valid.  Throws domain_error for a handle that refers to no
+    // patient of a queue with this structure.
+    void updatePatient(Handle handle, const Patient& updated);
+    // Removes the patient of handle from anywhere in the queue and returns
+    // it, in O(log n) like updatePatient.  The handle is no longer valid.
+    Patient removePatient(Handle handle);
+    const Record& getPatient(Handle handle) const;
+    // Cancels a patient who left without being seen, in O(1).  In pointer
+    // based heaps the node is only marked dead and stays in the heap until
+    // it reaches the root or the queue is compacted, DARY heaps remove the
+    // entry right away.  The handle is no longer valid.
+    void cancelPatient(Handle handle);
+    // Removes every cancelled node and rebuilds the heap in O(n).  Called
+    // by cancelPatient once the cancelled nodes are more than the threshold
+    // fraction of all nodes in the heap.
+    void compact();
+    double getCompactionThreshold() const;
+    // fraction between 0 and 1, throws out_of_range otherwise
+    void setCompactionThreshold(double threshold);
+    int numCancelled() const; // cancelled nodes still in the heap
     void clear();
-    int numPatients() const;
+    int numPatients() const; // O(1), the patients that were not cancelled
     // Print the queue using preorder traversal.  Although the first patient
     // printed should have the highest priority, the remaining patients will
     // not necessarily be in priority order.
     void printPatientQueue() const;
-    prifn_t getPriorityFn() const;
+    prifn_t getPriorityFn() const; // nullptr if a policy scores the queue
     // Set a new priority function.  Must rebuild the heap!!!
     void setPriorityFn(prifn_t priFn, HEAPTYPE heapType);
+    // Same, for a policy.  Rebuilds and bulk loads then score all their
+    // patients with scoreBatch before building the heap, instead of one
+    // call per patient.  Setting a priority function turns this off again.
+    void setPriorityPolicy(const PriorityPolicy& policy, HEAPTYPE heapType);
+    bool hasPriorityPolicy() const;
+    // throws domain_error if a priority function scores the queue
+    const PriorityPolicy& getPriorityPolicy() const;
     HEAPTYPE getHeapType() const;
     STRUCTURE getStructure() const;
-    // Set a new data structure (skew/leftist). Must rebuild the heap!!!
+    // Set a new data structure (skew/leftist/d-ary/pairing). Must rebuild the heap!!!
     void setStructure(STRUCTURE structure);
+    int getArity() const;
+    // Set the number of children per node of a DARY heap, at least 2
+    void setArity(int arity);
+    // Writes the queue to path in a compact, versioned binary format: the
+    // heap shape, cached keys, NPLs, cancelled nodes, heap type, structure
+    // and policy.  A priority function can not be saved, so a queue that
+    // loads a snapshot made without a policy keeps its own function, which
+    // must be the one the keys came from.  Throws runtime_error if the file
+    // can not be written.
+    void saveSnapshot(const string& path) const;
+    // Replaces the queue with the snapshot in path.  The file is mapped
+    // into memory where mmap is available and the nodes are rebuilt from
+    // it in one pass, without calling the priority function or merging.
+    // Handles into the old queue are no longer valid.  Throws runtime_error
+    // if the file can not be read and domain_error if it is not a snapshot
+    // of this version, leaving the queue as it was.
+    void loadSnapshot(const string& path);
+    // The counters and latency histograms of this queue since it was built
+    // or resetStats was called.  Built without PQUEUE_STATS nothing is
+    // counted and the stats are all 0, with m_enabled false.
+    PQueueStats getStats() const;
+    void resetStats();
+    // Measures the shape of the heap in O(n), see HeapReport.  Meant for
+    // spotting degenerate heaps in production and for deciding when to
+    // setStructure, where dump would print the whole tree.
+    HeapReport getHeapReport() const;
     void dump() const;  // For debugging purposes.
 
 private:
+    typedef NodeOf<Record> Node;
+
     Node * m_heap;          // Pointer to root of skew heap
-    int m_size;             // Current size of the heap
-    prifn_t m_priorFunc;    // Function to compute priority
+    int m_size;             // Current size of the heap, cancelled nodes too
+    int m_cancelled;        // cancelled nodes in the heap, never the root
+    double m_compactThreshold; // fraction of cancelled nodes that compacts
+    prifn_t m_priorFunc;    // Function to compute priority, unless m_hasPolicy
     HEAPTYPE m_heapType;    // either a MINHEAP or a MAXHEAP
     STRUCTURE m_structure;  // skew heap or leftist heap
+    vector<Node*> m_mergePath; // scratch space for leftist merges, not copied
+    NodePoolOf<Record> m_pool; // owns every node in m_heap
+
+    // The DARY heap keeps its keys apart from the patients, so sifting only
+    // moves small entries through one dense array.  An entry points at the
+    // slot of its patient in m_patients, and patients never move while
+    // they are queued.
+    struct HeapEntry {
+        int m_key;   // cached priority of the patient
+        int m_slot;  // index of the patient in m_patients
+    };
+    vector<HeapEntry> m_entries; // the d-ary heap, in level order
+    vector<Record> m_patients;   // patient payloads, indexed by slot
+    vector<int> m_freeSlots;     // slots of m_patients that are not in use
+    vector<int> m_positions;     // index in m_entries of each slot, -1 if free
+    int m_arity;                 // children per node of the d-ary heap
+    PriorityPolicy m_policy;     // computes the priority if m_hasPolicy
+    bool m_hasPolicy;
+#ifdef PQUEUE_STATS
+    mutable PQueueStats m_stats; // mutable, since priorityOf counts too
+#endif
 
     void dump(Node *pos) const; // helper function for dump
 
+    // the priority of a Patient or a stored Record
+    template <class P>
+    int priorityOf(const P& patient) const {
+        PQUEUE_COUNT(m_priorityCalls, 1);
+        return m_hasPolicy ? m_policy.score(patient) : m_priorFunc(asPatient(patient));
+    }
+
     /******************************************
     * Private function declarations go here! *
     ******************************************/
@@ -168,20 +1088,68 @@ private:
     void preOrder(Node* node) const;
     Node* mergeSkew(Node* p1, Node* p2);
     Node* mergeLeftist(Node* p1, Node* p2);
-    void updateNPL(Node* ptr);
+    Node* mergePairing(Node* p1, Node* p2);
+    Node* combineSiblings(Node* first);
+    Node* mergeNodes(Node* p1, Node* p2);
+    Node* findMatch(const Patient& patient) const;
+    void detachNode(Node* node);
+    void checkHandle(Handle handle) const;
+    void purgeTop();
+    void collectLive(vector<Node*>& nodes);
     int min(int x, int y);
     int NPL(Node* ptr);
     void countPatients(Node* ptr, int& count) const;
-    void deleteSubTree(Node* ptr);
+    bool sizeMatchesTree() const;
+    void reportArray(HeapReport& report, long long& depthSum) const;
+    void reportPairing(HeapReport& report, long long& depthSum) const;
+    void reportTree(HeapReport& report, long long& depthSum) const;
     Node* copyTree(const Node* ptr);
     Node* removeRoot(Node* ptr);
-    void insertWithDiffStructure(Node* ptr, PQueue& temp);
+    Node* heapify(vector<Node*>& nodes);
+    Node* meldAll(vector<Node*>& roots);
+    void takeTopNodes(int k, vector<Node*>& taken);
+    bool higherKey(int key1, int key2) const;
+    int insertEntry(Record&& patient, int key);
+    int appendEntry(Record&& patient, int key);
+    void reserveEntries(int count); // so appending count entries can not throw
+    void siftAppended(int added);
+    Patient removeEntryRoot();
+    Patient removeEntry(int index);
+    void moveEntry(int index, int key);
+    void siftUp(int index);
+    void siftDown(int index);
+    void buildArrayHeap();
+    void copyArray(const PQueueOf& rhs);
+    void clearArray();
+    void preOrderArray() const;
+    void dumpArray(int index) const;
+    bool heapPropertyArray() const;
+    bool heapPropertyPairing() const;
     bool heapPropertyMinTest();
     bool heapPropertyMin(Node* ptr);
     bool heapPropertyMaxTest();
     bool heapPropertyMax(Node* ptr);
     bool leftistProperty(Node* ptr);
     bool testNPL(Node* ptr);
+    bool samePriority(const PQueueOf& rhs) const;
+    static const int SCORECHUNK = 256; // patients scored per scoreBatch call
+    void scoreNodes(vector<Node*>& nodes);
+    void scoreEntries(int first);
+    void scoreRecords(const vector<Record>& records, vector<int>& keys);
+};
+
+// The queue of whole Patients
+class PQueue : public PQueueOf<Patient> {
+public:
+    using PQueueOf<Patient>::PQueueOf;
+};
+
+// The queue of PackedPatients, for big queues where memory matters more
+// than the cost of looking up names.  insertPatient packs the patient and
+// getNextPatient unpacks it again.
+class PackedPQueue : public PQueueOf<PackedPatient> {
+public:
+    using PQueueOf<PackedPatient>::PQueueOf;
 };
 
-#endif
\ No newline at end of file
+#endif